@@ -0,0 +1,142 @@
+/*
+    MIT License
+
+    xc-gui GUI for libahp_xc and OpenVLBI using the AHP XC correlators
+    Copyright (C) 2020  Ilia Platone
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef ACCUMULATOR_H
+#define ACCUMULATOR_H
+
+#include <cmath>
+#include <QVector>
+#include "kernels.h"
+
+/*
+ * Per-lag running mean and variance.
+ * Each lag keeps a weighted Welford accumulator whose mean and M2 sums
+ * are Kahan compensated, so integrations lasting hours do not drift.
+ * A non-zero decay weights older spectra down exponentially, decay 0
+ * gives the plain arithmetic mean.
+ */
+class Accumulator
+{
+    private:
+        QVector<double> weight;
+        QVector<double> weight2;
+        QVector<double> mean;
+        QVector<double> mean_c;
+        QVector<double> m2;
+        QVector<double> m2_c;
+        double decay { 0.0 };
+
+        static inline void kahan(double &sum, double &c, double value)
+        {
+            double y = value - c;
+            double t = sum + y;
+            c = (t - sum) - y;
+            sum = t;
+        }
+
+    public:
+        Accumulator() {}
+
+        inline void resize(int len)
+        {
+            for(QVector<double>* v : { &weight, &weight2, &mean, &mean_c, &m2, &m2_c })
+                v->resize(len);
+            reset();
+        }
+        inline void reset()
+        {
+            for(QVector<double>* v : { &weight, &weight2, &mean, &mean_c, &m2, &m2_c })
+                v->fill(0.0);
+        }
+        inline void clear()
+        {
+            resize(0);
+        }
+        inline int count()
+        {
+            return mean.count();
+        }
+        inline void setDecay(double value)
+        {
+            decay = fmin(1.0, fmax(0.0, value));
+        }
+        inline double getDecay()
+        {
+            return decay;
+        }
+        inline bool has(int lag)
+        {
+            return weight.at(lag) > 0.0;
+        }
+        inline void add(int lag, double y)
+        {
+            double keep = 1.0 - decay;
+            double w = weight.at(lag) * keep + 1.0;
+            weight[lag] = w;
+            weight2[lag] = weight2.at(lag) * keep * keep + 1.0;
+            double delta = y - mean.at(lag);
+            kahan(mean[lag], mean_c[lag], delta / w);
+            m2[lag] *= keep;
+            m2_c[lag] *= keep;
+            kahan(m2[lag], m2_c[lag], delta * (y - mean.at(lag)));
+        }
+        /*
+         * Stacks len lags from first at once, y = buf * scale + offset,
+         * lags where y is zero are skipped, the others get y - dark.
+         */
+        inline void add(int first, int len, const double *buf, double scale, double offset, const double *dark)
+        {
+            if(len <= 0)
+                return;
+            Kernels::Stack acc = { weight.data() + first, weight2.data() + first, mean.data() + first,
+                                   mean_c.data() + first, m2.data() + first, m2_c.data() + first };
+            Kernels::stack(acc, buf + first, dark + first, len, scale, offset, 1.0 - decay);
+        }
+        inline double getMean(int lag)
+        {
+            return mean.at(lag);
+        }
+        // unbiased variance with reliability weights
+        inline double variance(int lag)
+        {
+            double w = weight.at(lag);
+            if(w <= 0.0)
+                return 0.0;
+            double norm = w - weight2.at(lag) / w;
+            if(norm <= 0.0)
+                return 0.0;
+            return fmax(0.0, m2.at(lag)) / norm;
+        }
+        // standard error of the weighted mean
+        inline double error(int lag)
+        {
+            double w = weight.at(lag);
+            if(w <= 0.0)
+                return 0.0;
+            return sqrt(variance(lag) * weight2.at(lag)) / w;
+        }
+};
+
+#endif // ACCUMULATOR_H
@@ -0,0 +1,208 @@
+/*
+    MIT License
+
+    xc-gui GUI for libahp_xc and OpenVLBI using the AHP XC correlators
+    Copyright (C) 2020  Ilia Platone
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef ALIGNER_H
+#define ALIGNER_H
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <deque>
+#include <map>
+#include "latency.h"
+
+/*
+ * Long lived catalog alignment service shared by every Line and Polytope.
+ * Jobs are queued per owner and run in submission order on one worker
+ * thread. A job submitted while an older one of the same owner is still
+ * waiting replaces it in place, keeping its place and enqueue time, so a
+ * slow alignment never builds a backlog of stale spectra and waited()
+ * covers the whole wait. cancel() drops the waiting job, flags the
+ * running one and returns once it has left the worker, jobs poll the
+ * flag through isCancelled() between their steps. Each job knows how
+ * long it waited in the queue and how long it has been running.
+ */
+class Aligner
+{
+    public:
+        class Job
+        {
+                friend class Aligner;
+            private:
+                std::function<void(Job*)> func;
+                std::atomic<bool> cancelled { false };
+                qint64 queued { 0 };
+                qint64 started { 0 };
+            public:
+                inline bool isCancelled()
+                {
+                    return cancelled.load(std::memory_order_acquire);
+                }
+                inline qint64 waited()
+                {
+                    return started - queued;
+                }
+                inline qint64 elapsed()
+                {
+                    return Latency::now() - started;
+                }
+        };
+        typedef std::function<void(Job*)> job_func;
+    private:
+        typedef std::shared_ptr<Job> job_p;
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable wakeup;
+        std::condition_variable idle;
+        std::deque<const void*> order;
+        std::map<const void*, job_p> pending;
+        const void *owner { nullptr };
+        job_p running;
+        unsigned long submitted { 0 };
+        unsigned long coalesced { 0 };
+        unsigned long cancelled { 0 };
+        unsigned long completed { 0 };
+        bool quit { false };
+
+        inline void worker()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while(true)
+            {
+                wakeup.wait(lock, [&] { return quit || !order.empty(); });
+                if(quit)
+                    return;
+                owner = order.front();
+                order.pop_front();
+                running = pending[owner];
+                pending.erase(owner);
+                running->started = Latency::now();
+                lock.unlock();
+                if(!running->isCancelled())
+                    running->func(running.get());
+                lock.lock();
+                if(running->isCancelled())
+                    cancelled++;
+                else
+                    completed++;
+                running.reset();
+                owner = nullptr;
+                idle.notify_all();
+            }
+        }
+        Aligner()
+        {
+            thread = std::thread(&Aligner::worker, this);
+        }
+    public:
+        ~Aligner()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                quit = true;
+            }
+            wakeup.notify_all();
+            thread.join();
+        }
+        Aligner(const Aligner&) = delete;
+        Aligner& operator=(const Aligner&) = delete;
+
+        static inline Aligner *instance()
+        {
+            static Aligner aligner;
+            return &aligner;
+        }
+        inline void submit(const void *key, job_func func)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                submitted++;
+                auto it = pending.find(key);
+                if(it != pending.end())
+                {
+                    it->second->func = func;
+                    coalesced++;
+                    return;
+                }
+                job_p job(new Job());
+                job->func = func;
+                job->queued = Latency::now();
+                pending[key] = job;
+                order.push_back(key);
+            }
+            wakeup.notify_one();
+        }
+        inline void cancel(const void *key)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if(pending.erase(key) > 0)
+            {
+                for(auto it = order.begin(); it != order.end(); it++)
+                {
+                    if(*it == key)
+                    {
+                        order.erase(it);
+                        break;
+                    }
+                }
+                cancelled++;
+            }
+            if(owner == key && thread.get_id() != std::this_thread::get_id())
+            {
+                running->cancelled.store(true, std::memory_order_release);
+                idle.wait(lock, [&] { return owner != key; });
+            }
+        }
+        inline bool isBusy(const void *key)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return owner == key || pending.count(key) > 0;
+        }
+        inline unsigned long getSubmitted()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return submitted;
+        }
+        inline unsigned long getCoalesced()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return coalesced;
+        }
+        inline unsigned long getCancelled()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return cancelled;
+        }
+        inline unsigned long getCompleted()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return completed;
+        }
+};
+
+#endif // ALIGNER_H
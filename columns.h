@@ -0,0 +1,227 @@
+/*
+    MIT License
+
+    xc-gui GUI for libahp_xc and OpenVLBI using the AHP XC correlators
+    Copyright (C) 2020  Ilia Platone
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef COLUMNS_H
+#define COLUMNS_H
+
+#include <cmath>
+#include <cstring>
+#include <QtGlobal>
+#include <QMutex>
+#include <QVector>
+
+#define COLUMNS_ALIGNMENT 64
+#define COLUMNS_TIME -1
+
+/*
+ * Columnar sliding window: one timestamp column and a fixed number of
+ * value columns sharing the same rows. Each column is a cache line
+ * aligned ring of doubles, so a row costs one timestamp plus one double
+ * per channel and per-column loops run over contiguous memory. Missing
+ * values are stored as NaN. Rows are appended in time order and expire
+ * from the head in O(1); the rings double when full.
+ */
+class Columns
+{
+    private:
+        int columns;
+        int capacity { 0 };
+        int head { 0 };
+        int size { 0 };
+        double *time { nullptr };
+        QVector<double*> values;
+        QMutex mutex;
+        bool changed { false };
+
+        static double *allocColumn(int count)
+        {
+            return (double*)qMallocAligned(count * sizeof(double), COLUMNS_ALIGNMENT);
+        }
+        inline int mask()
+        {
+            return capacity - 1;
+        }
+        inline int index(int row)
+        {
+            return (head + row) & mask();
+        }
+        void copyColumn(const double *src, int row, int count, double *dst)
+        {
+            if(count <= 0)
+                return;
+            int start = index(row);
+            int first = qMin(count, capacity - start);
+            memcpy(dst, src + start, first * sizeof(double));
+            memcpy(dst + first, src, (count - first) * sizeof(double));
+        }
+        void grow()
+        {
+            int larger = qMax(64, capacity * 2);
+            double *column = allocColumn(larger);
+            if(time != nullptr) {
+                copyColumn(time, 0, size, column);
+                qFreeAligned(time);
+            }
+            time = column;
+            for(int c = 0; c < columns; c++) {
+                column = allocColumn(larger);
+                if(values[c] != nullptr) {
+                    copyColumn(values[c], 0, size, column);
+                    qFreeAligned(values[c]);
+                }
+                values[c] = column;
+            }
+            capacity = larger;
+            head = 0;
+        }
+
+    public:
+        Columns(int count) : columns(count), values(count, nullptr) {}
+        ~Columns()
+        {
+            qFreeAligned(time);
+            for(double *column : values)
+                qFreeAligned(column);
+        }
+        Columns(const Columns&) = delete;
+        Columns& operator=(const Columns&) = delete;
+
+        void lock()
+        {
+            mutex.lock();
+        }
+        void unlock()
+        {
+            mutex.unlock();
+        }
+        inline int count()
+        {
+            return size;
+        }
+        inline int getColumns()
+        {
+            return columns;
+        }
+        inline bool isEmpty()
+        {
+            return size == 0;
+        }
+        inline double getTime(int row)
+        {
+            return time[index(row)];
+        }
+        inline double getValue(int column, int row)
+        {
+            return values[column][index(row)];
+        }
+        inline double last(int column)
+        {
+            return (size > 0) ? getValue(column, size - 1) : NAN;
+        }
+        // appends a row, row holds one value per column
+        inline void append(double x, const double *row)
+        {
+            if(size == capacity)
+                grow();
+            int i = index(size);
+            time[i] = x;
+            for(int c = 0; c < columns; c++)
+                values[c][i] = row[c];
+            size++;
+            changed = true;
+        }
+        // drops the rows before min_x, calling expired(0) on each before it goes
+        template <typename F>
+        inline void expire(double min_x, F expired)
+        {
+            while(size > 0 && time[head] < min_x)
+            {
+                expired(0);
+                head = (head + 1) & mask();
+                size--;
+                changed = true;
+            }
+        }
+        // drops the oldest rows beyond rows, calling expired(0) on each before it goes
+        template <typename F>
+        inline void shrink(int rows, F expired)
+        {
+            while(size > rows)
+            {
+                expired(0);
+                head = (head + 1) & mask();
+                size--;
+                changed = true;
+            }
+        }
+        inline void clear()
+        {
+            head = 0;
+            size = 0;
+            changed = true;
+        }
+        /*
+         * Contiguous spans of a column in time order, COLUMNS_TIME gives the
+         * timestamps. Returns the length of the first span, the second
+         * one holds the remaining count() minus that.
+         */
+        inline int spans(int column, const double **first, const double **second)
+        {
+            const double *data = (column < 0) ? time : values[column];
+            *first = data + head;
+            *second = data;
+            return qMin(size, capacity - head);
+        }
+        inline void copy(int column, double *dst)
+        {
+            copyColumn((column < 0) ? time : values[column], 0, size, dst);
+        }
+        // copies count values of a column starting at row
+        inline void copy(int column, int row, int count, double *dst)
+        {
+            copyColumn((column < 0) ? time : values[column], row, count, dst);
+        }
+        // calls f(value) on each value of a column in time order
+        template <typename F>
+        inline void forEach(int column, F f)
+        {
+            const double *first;
+            const double *second;
+            int len = spans(column, &first, &second);
+            for(int x = 0; x < len; x++)
+                f(first[x]);
+            for(int x = 0; x < size - len; x++)
+                f(second[x]);
+        }
+        // returns whether rows were added or expired since the previous call
+        inline bool takeChanged()
+        {
+            bool c = changed;
+            changed = false;
+            return c;
+        }
+};
+
+#endif // COLUMNS_H
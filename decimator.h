@@ -0,0 +1,157 @@
+/*
+    MIT License
+
+    xc-gui GUI for libahp_xc and OpenVLBI using the AHP XC correlators
+    Copyright (C) 2020  Ilia Platone
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+#include <cmath>
+#include <QVector>
+#include <QPointF>
+#include <QXYSeries>
+
+using namespace QtCharts;
+
+/*
+ * Hands QtCharts at most two points per pixel column, the minimum and the
+ * maximum of the samples falling into it, in time order. Peaks survive at
+ * any zoom and the chart cost follows the plot width instead of the sample
+ * count. The samples are either the points kept here or any indexed source
+ * such as a Columns span. Decimation runs again only when the samples or
+ * the width change. Points with a non finite value are skipped.
+ */
+class Decimator
+{
+    private:
+        QXYSeries *series;
+        QVector<QPointF> points;
+        QVector<QPointF> decimated;
+        int width { -1 };
+        bool changed { false };
+
+    public:
+        Decimator(QXYSeries *s) : series(s) {}
+
+        inline QXYSeries *getSeries()
+        {
+            return series;
+        }
+        // full resolution points, call update() after changing them
+        inline QVector<QPointF> *getPoints()
+        {
+            return &points;
+        }
+        inline void update()
+        {
+            changed = true;
+        }
+        inline void clear()
+        {
+            points.clear();
+            changed = true;
+        }
+        // whether the samples or the width changed since the last decimation
+        inline bool isStale(int w)
+        {
+            return changed || w != width;
+        }
+        // decimates count samples returned by at(index) for a plot w pixels wide
+        template <typename F>
+        void decimate(int w, int count, F at)
+        {
+            changed = false;
+            width = w;
+            decimate(count, at, width, decimated);
+        }
+        // hands the last decimation to the chart series
+        inline void show()
+        {
+            series->replace(decimated);
+        }
+        void publish(int w)
+        {
+            if(!isStale(w))
+                return;
+            decimate(w, points.count(), [ = ] (int x) { return points.at(x); });
+            show();
+        }
+
+        template <typename F>
+        static void decimate(int count, F at, int width, QVector<QPointF> &out)
+        {
+            out.clear();
+            if(count == 0)
+                return;
+            double start = at(0).x();
+            double end = at(count - 1).x();
+            if(width <= 0 || count <= width * 2 || end <= start) {
+                out.reserve(count);
+                for(int x = 0; x < count; x++) {
+                    QPointF p = at(x);
+                    if(std::isfinite(p.y()))
+                        out.append(p);
+                }
+                return;
+            }
+            double scale = width / (end - start);
+            out.reserve(width * 2);
+            int column = -1;
+            int lo = 0;
+            int hi = 0;
+            QPointF lo_p;
+            QPointF hi_p;
+            for(int x = 0; x <= count; x++)
+            {
+                QPointF p;
+                int c = width;
+                if(x < count) {
+                    p = at(x);
+                    if(!std::isfinite(p.y()))
+                        continue;
+                    c = qMin(width - 1, (int)((p.x() - start) * scale));
+                }
+                if(c != column) {
+                    if(column >= 0) {
+                        out.append(lo < hi ? lo_p : hi_p);
+                        if(lo != hi)
+                            out.append(lo < hi ? hi_p : lo_p);
+                    }
+                    column = c;
+                    lo = hi = x;
+                    lo_p = hi_p = p;
+                    continue;
+                }
+                if(p.y() < lo_p.y()) {
+                    lo = x;
+                    lo_p = p;
+                }
+                if(p.y() > hi_p.y()) {
+                    hi = x;
+                    hi_p = p;
+                }
+            }
+        }
+};
+
+#endif // DECIMATOR_H
@@ -0,0 +1,111 @@
+/*
+    MIT License
+
+    xc-gui GUI for libahp_xc and OpenVLBI using the AHP XC correlators
+    Copyright (C) 2020  Ilia Platone
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef DISPATCHER_H
+#define DISPATCHER_H
+
+#include <atomic>
+#include <functional>
+#include <QVector>
+#include <ahp_xc.h>
+#include "workers.h"
+
+/*
+ * Delivers batches of packets to the consumers that are currently active.
+ * Every consumer registers an activity test and a batch handler, the flat
+ * table of active handlers is rebuilt on the dispatching thread only after
+ * invalidate() has been called, so steady state costs one call per active
+ * consumer per batch. Consumers own their state, so the active handlers of
+ * a batch run in parallel on a worker pool and dispatch() returns once
+ * all of them are done. Serial consumers, those driving the hardware, run
+ * first and in order on the dispatching thread.
+ */
+class Dispatcher
+{
+    public:
+        typedef std::function<bool()> active_func;
+        typedef std::function<void(ahp_xc_packet **packets, size_t count)> consume_func;
+    private:
+        typedef struct
+        {
+            active_func active;
+            consume_func consume;
+            bool serial;
+        } consumer;
+        QVector<consumer> consumers;
+        QVector<consume_func> serial;
+        QVector<consume_func> table;
+        std::atomic<bool> dirty { true };
+        Workers workers;
+        inline void rebuild()
+        {
+            serial.clear();
+            table.clear();
+            for(const consumer &c : consumers)
+            {
+                if(c.active())
+                    (c.serial ? serial : table).append(c.consume);
+            }
+        }
+    public:
+        Dispatcher(int threads = 1) : workers(threads) {}
+
+        inline void addConsumer(active_func active, consume_func consume, bool serial = false)
+        {
+            consumer c = { active, consume, serial };
+            consumers.append(c);
+            invalidate();
+        }
+        inline void clear()
+        {
+            consumers.clear();
+            serial.clear();
+            table.clear();
+            invalidate();
+        }
+        inline void invalidate()
+        {
+            dirty.store(true, std::memory_order_release);
+        }
+        inline int activeCount()
+        {
+            return serial.count() + table.count();
+        }
+        inline void dispatch(ahp_xc_packet **packets, size_t count)
+        {
+            if(dirty.exchange(false, std::memory_order_acq_rel))
+                rebuild();
+            if(count == 0)
+                return;
+            for(int x = 0; x < serial.count(); x++)
+                serial[x](packets, count);
+            workers.run(table.count(), [&] (int x)
+            {
+                table[x](packets, count);
+            });
+        }
+};
+
+#endif // DISPATCHER_H
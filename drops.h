@@ -0,0 +1,156 @@
+/*
+    MIT License
+
+    xc-gui GUI for libahp_xc and OpenVLBI using the AHP XC correlators
+    Copyright (C) 2020  Ilia Platone
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef DROPS_H
+#define DROPS_H
+
+#include <atomic>
+#include <cmath>
+#include <QString>
+#include <QElapsedTimer>
+
+/*
+ * Accounting of the packets lost on the acquisition path.
+ * Gaps are packets missing from the device stream, inferred from the
+ * distance between consecutive timestamps in units of the packet time.
+ * Late, ring full and pool empty count packets read but thrown away,
+ * read errors count failed reads which returned no packet.
+ * Counters are atomic so totals can be read from any thread.
+ */
+class Drops
+{
+    public:
+        enum Cause
+        {
+            Gap = 0,
+            Late,
+            RingFull,
+            PoolEmpty,
+            ReadError,
+            Causes
+        };
+
+    private:
+        std::atomic<quint64> counts[Causes];
+        std::atomic<quint64> received { 0 };
+        std::atomic<quint64> discontinuities { 0 };
+        double previous { 0.0 };
+        bool first { true };
+        QElapsedTimer clock;
+
+    public:
+        Drops()
+        {
+            reset();
+        }
+        Drops(const Drops&) = delete;
+        Drops& operator=(const Drops&) = delete;
+
+        static inline QString causeName(Cause cause)
+        {
+            switch(cause)
+            {
+                case Gap: return "gap";
+                case Late: return "late";
+                case RingFull: return "ring full";
+                case PoolEmpty: return "pool empty";
+                case ReadError: return "read error";
+                default: return "";
+            }
+        }
+        inline void reset()
+        {
+            for(int x = 0; x < Causes; x++)
+                counts[x].store(0);
+            received.store(0);
+            discontinuities.store(0);
+            first = true;
+            previous = 0.0;
+            clock.start();
+        }
+        inline void account(Cause cause, quint64 n = 1)
+        {
+            counts[cause].fetch_add(n, std::memory_order_relaxed);
+        }
+        // called by the reader for every packet it gets, in stream order
+        inline void receive(double timestamp, double packettime)
+        {
+            received.fetch_add(1, std::memory_order_relaxed);
+            if(!first && packettime > 0.0)
+            {
+                double diff = timestamp - previous;
+                if(diff <= 0.0)
+                    discontinuities.fetch_add(1, std::memory_order_relaxed);
+                else if(diff > packettime * 1.5)
+                {
+                    account(Gap, (quint64)llround(diff / packettime) - 1);
+                    discontinuities.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            previous = timestamp;
+            first = false;
+        }
+        inline quint64 count(Cause cause)
+        {
+            return counts[cause].load(std::memory_order_relaxed);
+        }
+        inline quint64 getReceived()
+        {
+            return received.load(std::memory_order_relaxed);
+        }
+        inline quint64 getDiscontinuities()
+        {
+            return discontinuities.load(std::memory_order_relaxed);
+        }
+        inline quint64 lost()
+        {
+            return count(Gap) + count(Late) + count(RingFull) + count(PoolEmpty);
+        }
+        // average rate since reset(), per second
+        inline double rate(Cause cause)
+        {
+            double seconds = clock.elapsed() / 1000.0;
+            return (seconds > 0.0) ? count(cause) / seconds : 0.0;
+        }
+        // fraction of the packets the device sent which never reached the consumers
+        inline double lossRatio()
+        {
+            quint64 sent = getReceived() + count(Gap);
+            return (sent > 0) ? (double)lost() / sent : 0.0;
+        }
+        inline QString summary()
+        {
+            QString text = QString("Packets: %1 received, %2 lost (%3%)").arg(getReceived()).arg(lost()).arg(lossRatio() * 100.0, 0, 'f', 3);
+            for(int x = 0; x < Causes; x++)
+            {
+                Cause cause = (Cause)x;
+                if(count(cause) > 0)
+                    text += QString(", %1 %2 (%3/s)").arg(causeName(cause)).arg(count(cause)).arg(rate(cause), 0, 'f', 1);
+            }
+            return text;
+        }
+};
+
+#endif // DROPS_H
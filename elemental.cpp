@@ -25,54 +25,72 @@
 
 #include "elemental.h"
 
-Elemental::Elemental(QObject *parent) : QObject(parent)
+Elemental::Buffer::Buffer()
 {
-    histo = dsp_stream_new();
-    dsp_stream_add_dim(histo, 1);
-    dsp_stream_alloc_buffer(histo, histo->len);
     stream = dsp_stream_new();
     stream->magnitude = dsp_stream_new();
     stream->phase = dsp_stream_new();
     dsp_stream_add_dim(stream, 1);
     dsp_stream_add_dim(stream, 1);
     dsp_stream_alloc_buffer(stream, stream->len);
-    scanThread = new Thread(this);
-    connect(scanThread, static_cast<void (Thread::*)(Thread*)>(&Thread::threadLoop), [ = ] (Thread * thread)
-    {
-        Elemental* parent = (Elemental*)thread->getParent();
-        while(!lock()) { QThread::msleep(100); }
-        dsp_stream_p stream = parent->getStream();
-        success = false;
-        offset = 0.0;
-        scale = 1.0;
-        if(stream->stars_count > 2 && reference->stars_count > 2)
-        {
-            dsp_align_info info = vlbi_astro_align_spectra(stream, reference, parent->getMaxDots(), parent->getDecimals(),
-                                  parent->getMinScore());
-            success = (info.err & DSP_ALIGN_NO_MATCH) == 0;
-            if(success)
-            {
-                pwarn("Match found - score: %lf%%\n offset: %lf\n scale: %lf\n", 100.0 - info.score * 100.0, info.offset[0],
-                      info.factor[0]);
-                offset = info.offset[0];
-                scale = info.factor[0];
-                matches++;
-            }
-        }
-        unlock();
-        finish(success, offset, scale);
-        thread->stop();
-        thread->unlock();
-    });
 }
 
-Elemental::~Elemental()
+Elemental::Buffer::~Buffer()
 {
-    scanThread->~Thread();
     dsp_stream_free_buffer(stream);
     dsp_stream_free(stream);
 }
 
+Elemental::Elemental(QObject *parent) : QObject(parent)
+{
+    histo = dsp_stream_new();
+    dsp_stream_add_dim(histo, 1);
+    dsp_stream_alloc_buffer(histo, histo->len);
+    back = Snapshot(new Buffer());
+    buffers.append(back);
+    stream = back->stream;
+}
+
+Elemental::~Elemental()
+{
+    Aligner::instance()->cancel(this);
+    buffers.clear();
+    back.reset();
+    std::atomic_store(&front, Snapshot());
+    std::atomic_store(&result, Result());
+}
+
+void Elemental::publish()
+{
+    Qt::HANDLE self = QThread::currentThreadId();
+    Qt::HANDLE first = nullptr;
+    producer.compare_exchange_strong(first, self);
+    Q_ASSERT(first == nullptr || first == self);
+    std::atomic_store(&front, back);
+    back.reset();
+    for(const Snapshot &buffer : buffers)
+    {
+        // only the pool holds it, so no reader can reach it any more
+        if(buffer != front && buffer.use_count() == 1)
+        {
+            back = buffer;
+            break;
+        }
+    }
+    if(back == nullptr)
+    {
+        back = Snapshot(new Buffer());
+        buffers.append(back);
+    }
+    dsp_stream_set_dim(back->stream, 0, stream->len);
+    dsp_stream_alloc_buffer(back->stream, back->stream->len);
+    dsp_buffer_copy(stream->buf, back->stream->buf, stream->len);
+    dsp_buffer_copy(stream->magnitude->buf, back->stream->magnitude->buf, stream->len);
+    dsp_buffer_copy(stream->phase->buf, back->stream->phase->buf, stream->len);
+    memcpy(back->stream->dft.complex, stream->dft.complex, sizeof(*stream->dft.complex) * stream->len);
+    stream = back->stream;
+}
+
 QStringList Elemental::getElementNames()
 {
     QStringList names;
@@ -83,39 +101,53 @@ QStringList Elemental::getElementNames()
     return names;
 }
 
+Elemental::Catalog::~Catalog()
+{
+    for (dsp_stream_p element : elements)
+    {
+        dsp_stream_free_buffer(element);
+        dsp_stream_free(element);
+    }
+    if(reference != nullptr)
+    {
+        dsp_stream_free_buffer(reference);
+        dsp_stream_free(reference);
+    }
+}
+
 void Elemental::loadSpectrum(QString spectrumPath)
 {
-    unloadCatalog();
-    reference = vlbi_astro_load_spectrum((char*)spectrumPath.toStdString().c_str());
+    catalog_p loaded(new Catalog());
+    loaded->reference = vlbi_astro_load_spectrum((char*)spectrumPath.toStdString().c_str());
+    lock();
+    catalog.swap(loaded);
+    unlock();
 }
 
 void Elemental::loadCatalog(QString catalogPath)
 {
     unloadCatalog();
-    dsp_stream_p *catalog = nullptr;
+    dsp_stream_p *spectra = nullptr;
     int catalog_size = 0;
-    vlbi_astro_load_spectra_catalog((char*)catalogPath.toStdString().c_str(), &catalog, &catalog_size);
-    reference = vlbi_astro_create_reference_catalog(catalog, catalog_size);
+    vlbi_astro_load_spectra_catalog((char*)catalogPath.toStdString().c_str(), &spectra, &catalog_size);
+    catalog_p loaded(new Catalog());
+    loaded->reference = vlbi_astro_create_reference_catalog(spectra, catalog_size);
     for(int c = 0; c < catalog_size; c++)
     {
-        elements.append(catalog[c]);
+        loaded->elements.append(spectra[c]);
     }
+    loaded->index.build(loaded->elements);
+    lock();
+    catalog.swap(loaded);
+    unlock();
 }
 
 void Elemental::unloadCatalog()
 {
-    if(elements.empty())
-        return;
-    for (dsp_stream_p element : elements)
-    {
-        dsp_stream_free_buffer(element);
-        dsp_stream_free(element);
-    }
-    if(reference != nullptr)
-    {
-        dsp_stream_free_buffer(reference);
-        dsp_stream_free(reference);
-    }
+    catalog_p loaded;
+    lock();
+    catalog.swap(loaded);
+    unlock();
 }
 
 dsp_align_info *Elemental::stats(QString name)
@@ -132,84 +164,188 @@ dsp_align_info *Elemental::stats(QString name)
 
 void Elemental::run()
 {
-    while(!lock()) QThread::msleep(100);
     vlbi_astro_scan_spectrum(stream, getSampleSize());
     pwarn("Found %d lines\n", stream->stars_count);
+    publish();
+    Snapshot spectrum = snapshot();
+    Aligner::instance()->submit(this, [ = ] (Aligner::Job * job)
+    {
+        align(job, spectrum);
+    });
+}
+
+QList<dsp_stream_p> Elemental::match(Aligner::Job *job, dsp_stream_p spectrum, const QList<dsp_stream_p> &candidates)
+{
+    return Matcher::instance()->match(spectrum, candidates, getTopMatches(), getMaxDots(), getDecimals(), getMinScore(), [ = ] ()
+    {
+        return job->isCancelled();
+    }, [ = ] (dsp_stream_p element, int rank)
+    {
+        emit elementMatched(QString(element->name), rank);
+    });
+}
+
+void Elemental::align(Aligner::Job *job, Snapshot spectrum)
+{
+    bool done = false;
+    double ofs = 0.0;
+    double sc = 1.0;
+    QStringList ranking;
+    QString unconfirmed;
+    lock();
+    catalog_p loaded = catalog;
     unlock();
-    if(!scanThread->isRunning())
-        scanThread->start();
+    if(loaded != nullptr && !job->isCancelled() && spectrum->stream->stars_count > 2)
+    {
+        QList<dsp_stream_p> &elements = loaded->elements;
+        dsp_stream_p reference = loaded->reference;
+        dsp_align_info info;
+        if(!elements.isEmpty())
+        {
+            std::vector<LineIndex::candidate> hypotheses = loaded->index.candidates(spectrum->stream, LINEINDEX_CANDIDATES);
+            QList<dsp_stream_p> candidates;
+            for(const LineIndex::candidate &c : hypotheses)
+                candidates.append(c.element);
+            pwarn("%d of %d elements left after pruning\n", candidates.count(), elements.count());
+            QList<dsp_stream_p> best = match(job, spectrum->stream, candidates);
+            for(dsp_stream_p element : best)
+                ranking.append(element->name);
+            done = !best.isEmpty();
+            if(done)
+                info = best[0]->align_info;
+            else if(!hypotheses.empty())
+            {
+                // no alignment reached the minimum score, the best index hypothesis is only reported
+                const LineIndex::candidate &h = hypotheses[0];
+                pwarn("No match, unconfirmed line index fit of %s - %d lines\n offset: %lf\n scale: %lf\n", h.element->name, h.inliers, h.offset, h.scale);
+                unconfirmed = h.element->name;
+            }
+        }
+        else if(reference != nullptr && reference->stars_count > 2)
+        {
+            info = vlbi_astro_align_spectra(spectrum->stream, reference, getMaxDots(), getDecimals(), getMinScore());
+            done = (info.err & DSP_ALIGN_NO_MATCH) == 0;
+        }
+        if(done)
+        {
+            pwarn("Match found - score: %lf%%\n offset: %lf\n scale: %lf\n", 100.0 - info.score * 100.0, info.offset[0],
+                  info.factor[0]);
+            ofs = info.offset[0];
+            sc = info.factor[0];
+            matches++;
+        }
+    }
+    if(job->isCancelled())
+        return;
+    success = done;
+    offset = ofs;
+    scale = sc;
+    alignWait = job->waited();
+    alignTime = job->elapsed();
+    pwarn("Alignment took %.1lf ms after %.1lf ms in queue\n", alignTime / 1000000.0, alignWait / 1000000.0);
+    finish(success, offset, scale, spectrum, ranking, unconfirmed);
 }
 
-void Elemental::finish(bool done, double ofs, double sc)
+void Elemental::finish(bool done, double ofs, double sc, Snapshot spectrum, QStringList ranking, QString unconfirmed)
 {
+    Result finished(new Alignment());
+    finished->spectrum = (spectrum != nullptr) ? spectrum : snapshot();
+    finished->success = done;
+    finished->offset = ofs;
+    finished->scale = sc;
+    finished->ranking = ranking;
+    finished->unconfirmed = unconfirmed;
+    std::atomic_store(&result, finished);
     emit scanFinished(done, ofs, sc);
 }
 
 void Elemental::setBuffer(double * buf, int len)
 {
-    while(!lock()) QThread::msleep(100);
     success = false;
     offset = 0.0;
     scale = 1.0;
     dsp_stream_set_dim(stream, 0, len);
     dsp_stream_alloc_buffer(stream, stream->len);
     dsp_buffer_copy(buf, stream->buf, stream->len);
-    unlock();
 }
 
 void Elemental::setMagnitude(double * buf, int len)
 {
-    while(!lock()) QThread::msleep(100);
     dsp_stream_set_dim(stream, 0, len);
     dsp_stream_alloc_buffer(stream, stream->len);
     dsp_buffer_copy(buf, stream->magnitude->buf, stream->len);
-    unlock();
 }
 
 void Elemental::setPhase(double * buf, int len)
 {
-    while(!lock()) QThread::msleep(100);
     dsp_stream_set_dim(stream, 0, len);
     dsp_stream_alloc_buffer(stream, stream->len);
     dsp_buffer_copy(buf, stream->phase->buf, stream->len);
-    unlock();
 }
 
 void Elemental::setReal(double * buf, int len)
 {
-    while(!lock()) QThread::msleep(100);
     dsp_stream_set_dim(stream, 0, len);
     dsp_stream_alloc_buffer(stream, stream->len);
     for(int i = 0; i < stream->len; i++)
         stream->dft.complex[i].real = buf[i];
     dsp_fourier_2dsp(stream);
-    unlock();
 }
 
 void Elemental::setImaginary(double * buf, int len)
 {
-    while(!lock()) QThread::msleep(100);
     dsp_stream_set_dim(stream, 0, len);
     dsp_stream_alloc_buffer(stream, stream->len);
     for(int i = 0; i < stream->len; i++)
         stream->dft.complex[i].imaginary = buf[i];
     dsp_fourier_2dsp(stream);
-    unlock();
 }
 
 void Elemental::idft()
 {
-    while(!lock()) QThread::msleep(100);
-    dsp_fourier_idft(stream);
-    unlock();
-}
-
-void Elemental::dft(int depth)
-{
-    while(!lock()) QThread::msleep(100);
-    dsp_fourier_dft(stream, depth);
-    dsp_fourier_2dsp(stream);
-    unlock();
+    int len = stream->len;
+    fftw_plan plan = verified.value(len, true) ? Plans::get(len, FFTW_BACKWARD, Plans::threads(len)) : nullptr;
+    if(plan == nullptr)
+    {
+        dsp_fourier_idft(stream);
+        return;
+    }
+    // the first transform of each size is done by libdsp too and compared
+    std::unique_ptr<Buffer> check;
+    if(!verified.contains(len))
+    {
+        check.reset(new Buffer());
+        dsp_stream_set_dim(check->stream, 0, len);
+        dsp_stream_alloc_buffer(check->stream, check->stream->len);
+        dsp_buffer_copy(stream->buf, check->stream->buf, len);
+        dsp_buffer_copy(stream->magnitude->buf, check->stream->magnitude->buf, len);
+        dsp_buffer_copy(stream->phase->buf, check->stream->phase->buf, len);
+        memcpy(check->stream->dft.complex, stream->dft.complex, sizeof(*stream->dft.complex) * len);
+        dsp_fourier_idft(check->stream);
+    }
+    double mn = dsp_stats_min(stream->buf, len);
+    double mx = dsp_stats_max(stream->buf, len);
+    for(int i = 0; i < len / 2 + 1; i++)
+    {
+        stream->dft.complex[i].real = stream->magnitude->buf[i] * cos(stream->phase->buf[i]);
+        stream->dft.complex[i].imaginary = stream->magnitude->buf[i] * sin(stream->phase->buf[i]);
+    }
+    fftw_execute_dft_c2r(plan, (fftw_complex*)stream->dft.complex, stream->buf);
+    // keep the range of the spectrum it replaces
+    dsp_buffer_stretch(stream->buf, len, mn, mx);
+    if(check != nullptr)
+    {
+        double tolerance = fmax(1.0, mx - mn) * 0.000000001;
+        bool same = true;
+        for(int i = 0; i < len && same; i++)
+            same = fabs(check->stream->buf[i] - stream->buf[i]) <= tolerance;
+        verified[len] = same;
+        if(!same)
+        {
+            pwarn("Cached inverse transform of size %d differs from libdsp, using libdsp\n", len);
+            dsp_buffer_copy(check->stream->buf, stream->buf, len);
+        }
+    }
 }
 
 void Elemental::clear()
@@ -219,37 +355,28 @@ void Elemental::clear()
 
 double Elemental::min(off_t offset, size_t len)
 {
-    while(!lock()) QThread::msleep(100);
     double min = dsp_stats_min(((dsp_t*)&getStream()->buf[offset]), len);
-    unlock();
     return min;
 }
 
 double Elemental::max(off_t offset, size_t len)
 {
-    while(!lock()) QThread::msleep(100);
     double max = dsp_stats_max(((dsp_t*)&getStream()->buf[offset]), len);
-    unlock();
     return max;
 }
 
 void Elemental::normalize(double min, double max)
 {
-    while(!lock()) QThread::msleep(100);
     dsp_buffer_normalize(getStream()->buf, getStreamSize(), min, max);
-    unlock();
 }
 
 void Elemental::stretch(double min, double max)
 {
-    while(!lock()) QThread::msleep(100);
     dsp_buffer_stretch(getStream()->buf, getStreamSize(), min, max);
-    unlock();
 }
 
 dsp_stream_p Elemental::histogram(int size, dsp_stream_p str)
 {
-    while(!lock()) QThread::msleep(100);
     if(str == nullptr)
         str = getStream();
     dsp_stream_p tmp = dsp_stream_copy(str);
@@ -266,6 +393,5 @@ dsp_stream_p Elemental::histogram(int size, dsp_stream_p str)
     dsp_stream_free_buffer(tmp);
     dsp_stream_free(tmp);
     free(tmphisto);
-    unlock();
     return histo;
 }
@@ -1,20 +1,90 @@
 #ifndef ELEMENTAL_H
 #define ELEMENTAL_H
 
+#include <atomic>
+#include <memory>
 #include <QFileInfo>
 #include <QObject>
 #include <QDir>
 #include <QMap>
 #include "types.h"
+#include "aligner.h"
+#include "plans.h"
+#include "matcher.h"
+#include "lineindex.h"
 
+/*
+ * The spectrum of a Series with its line scan and catalog alignment.
+ * The producer fills a back buffer through the mutators and getters
+ * below, then publish() makes it the front snapshot with an atomic
+ * store. The new back buffer starts as a copy of the front, so producers
+ * may update it in part. Readers take the front with snapshot() and keep
+ * it alive for as long as they hold it, so they never see a half written
+ * spectrum and never wait on the producer. There is one producer thread,
+ * debug builds assert it. A finished scan keeps the snapshot it
+ * was aligned on next to its offset and scale, so the plot never pairs
+ * an alignment with a newer spectrum. The mutex only guards the catalog
+ * pointer, an alignment holds on to the catalog it started with and
+ * matches without the lock, so loading another one never waits for it.
+ * Alignment runs on the shared Aligner, a newer run() replaces a
+ * spectrum still waiting there. With a catalog loaded the line index
+ * picks the candidate elements, each of them is matched on its own and
+ * the best ones are ranked, otherwise the spectrum is aligned to the
+ * single reference. Elements the index leaves out are not tried, when no
+ * candidate reaches the minimum score the scan has no match and only
+ * names the best index hypothesis as unconfirmed.
+ */
 class Elemental : public QObject
 {
         Q_OBJECT
+    public:
+        class Buffer
+        {
+            public:
+                Buffer();
+                ~Buffer();
+                Buffer(const Buffer&) = delete;
+                Buffer& operator=(const Buffer&) = delete;
+                dsp_stream_p stream;
+        };
+        typedef std::shared_ptr<Buffer> Snapshot;
+        // a finished scan, the spectrum it was aligned on and the fit
+        class Alignment
+        {
+            public:
+                Snapshot spectrum;
+                bool success { false };
+                double offset { 0.0 };
+                double scale { 1.0 };
+                QStringList ranking;
+                // the line index hypothesis of a scan without a match
+                QString unconfirmed;
+        };
+        typedef std::shared_ptr<Alignment> Result;
+        // a loaded catalog, its spectra are freed with the last reference to it
+        class Catalog
+        {
+            public:
+                Catalog() {}
+                ~Catalog();
+                Catalog(const Catalog&) = delete;
+                Catalog& operator=(const Catalog&) = delete;
+                dsp_stream_p reference { nullptr };
+                QList <dsp_stream_p> elements;
+                LineIndex index;
+        };
+        typedef std::shared_ptr<Catalog> catalog_p;
+
     private:
         QMutex mutex;
         int matches;
-        Thread *scanThread;
         dsp_stream_p histo;
+        QList<Snapshot> buffers;
+        Snapshot back;
+        Snapshot front;
+        std::atomic<Qt::HANDLE> producer { nullptr };
+        Result result;
+        catalog_p catalog;
         dsp_stream_p stream;
         bool success { false };
         double offset { 0.0 };
@@ -23,17 +93,34 @@ class Elemental : public QObject
         int maxDots {10};
         int decimals { 0 };
         int minScore { 50 };
+        int topMatches { 5 };
+        qint64 alignWait { 0 };
+        qint64 alignTime { 0 };
+        // sizes whose cached inverse transform was compared with libdsp, and the outcome
+        QMap<int, bool> verified;
+        QList<dsp_stream_p> match(Aligner::Job *job, dsp_stream_p spectrum, const QList<dsp_stream_p> &candidates);
+        void align(Aligner::Job *job, Snapshot spectrum);
 
     public:
         explicit Elemental(QObject *parent = nullptr);
         ~Elemental();
 
-        inline bool lock() { return mutex.tryLock(10); }
+        inline void lock() { mutex.lock(); }
         inline void unlock() { mutex.unlock(); }
+        // the last published spectrum
+        inline Snapshot snapshot()
+        {
+            return std::atomic_load(&front);
+        }
+        // the last finished scan, plot this rather than the newest snapshot
+        inline Result alignment()
+        {
+            return std::atomic_load(&result);
+        }
+        void publish();
         void run();
-        void finish(bool done = false, double ofs = 0.0, double sc = 1.0);
-        dsp_stream_p reference;
-        QList <dsp_stream_p> elements;
+        // spectrum defaults to the last published one
+        void finish(bool done = false, double ofs = 0.0, double sc = 1.0, Snapshot spectrum = Snapshot(), QStringList ranking = QStringList(), QString unconfirmed = QString());
 
         inline void set(double value)
         {
@@ -66,6 +153,26 @@ class Elemental : public QObject
         {
             return minScore;
         }
+        inline void setTopMatches(int value)
+        {
+            topMatches = value;
+        }
+        inline int getTopMatches()
+        {
+            return topMatches;
+        }
+        // names of the best catalog matches of the last alignment, best first
+        inline QStringList getRanking()
+        {
+            Result last = alignment();
+            return (last != nullptr) ? last->ranking : QStringList();
+        }
+        // best line index hypothesis of the last alignment when nothing matched, empty otherwise
+        inline QString getUnconfirmed()
+        {
+            Result last = alignment();
+            return (last != nullptr) ? last->unconfirmed : QString();
+        }
         inline double getOffset()
         {
             return offset;
@@ -74,13 +181,21 @@ class Elemental : public QObject
         {
             return scale;
         }
+        // nanoseconds the last alignment spent queued and running
+        inline qint64 getAlignWait()
+        {
+            return alignWait;
+        }
+        inline qint64 getAlignTime()
+        {
+            return alignTime;
+        }
         void setBuffer(double * buf, int len);
         void setMagnitude(double * buf, int len);
         void setPhase(double * buf, int len);
         void setReal(double * buf, int len);
         void setImaginary(double * buf, int len);
         void idft();
-        void dft(int depth = 1);
         inline void setSampleSize(int value)
         {
             sample = value;
@@ -128,11 +243,15 @@ class Elemental : public QObject
         void unloadCatalog();
         inline QList <dsp_stream_p> getCatalog()
         {
-            return Elemental::elements;
+            lock();
+            catalog_p loaded = catalog;
+            unlock();
+            return (loaded != nullptr) ? loaded->elements : QList <dsp_stream_p>();
         }
 
     signals:
         void scanFinished(bool, double, double );
+        void elementMatched(QString, int);
 };
 
 
@@ -0,0 +1,182 @@
+/*
+    MIT License
+
+    xc-gui GUI for libahp_xc and OpenVLBI using the AHP XC correlators
+    Copyright (C) 2020  Ilia Platone
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef EMULATOR_H
+#define EMULATOR_H
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <QString>
+#include <QThread>
+#include <QElapsedTimer>
+#include <ahp_xc.h>
+#include "source.h"
+
+/*
+ * Synthetic correlator generating packets for any number of lines.
+ * Each line counts rate photons per second modulated by a sinusoid of
+ * the given amplitude and frequency, shifted in phase across lines, plus
+ * shot noise. Crosscorrelations are not computed from the counts, every
+ * baseline gets a Gaussian peak of weight correlation placed delay lags
+ * per line of separation away from the center lag, plus independent
+ * noise on each lag.
+ * Packets come out every packettime seconds divided by speed, a speed of
+ * 0 generates them as fast as the consumers allow.
+ */
+class Emulator : public Source
+{
+    private:
+        std::mt19937 generator;
+        std::normal_distribution<double> gaussian { 0.0, 1.0 };
+        quint64 packets { 0 };
+        double speed { 1.0 };
+        bool started { false };
+        double origin { 0.0 };
+        bool opened { false };
+        QElapsedTimer clock;
+        double rate { 10000.0 };
+        double correlation { 0.5 };
+        double delay { 1.0 };
+        double amplitude { 0.1 };
+        double frequency { 1.0 };
+
+        static inline void setCorrelation(ahp_xc_correlation *correlation, double magnitude, double phase)
+        {
+            correlation->magnitude = magnitude;
+            correlation->phase = phase;
+            correlation->real = magnitude * cos(phase);
+            correlation->imaginary = magnitude * sin(phase);
+        }
+
+    public:
+        Emulator() {}
+        ~Emulator()
+        {
+            close();
+        }
+
+        inline bool open(int nlines, int autolag, int crosslag, double packettime)
+        {
+            close();
+            if(nlines < 1 || autolag < 1 || crosslag < 1 || packettime <= 0.0)
+                return false;
+            memset(&header, 0, sizeof(Recorder::Header));
+            memcpy(header.magic, RECORDER_MAGIC, sizeof(header.magic));
+            header.version = RECORDER_VERSION;
+            header.header_size = sizeof(Recorder::Header);
+            snprintf(header.device, sizeof(header.device), "EMULATOR%d", nlines);
+            header.nlines = nlines;
+            header.nbaselines = nlines * (nlines - 1) / 2;
+            header.autolag = autolag;
+            header.crosslag = crosslag;
+            header.correlation_size = sizeof(ahp_xc_correlation);
+            header.record_size = Recorder::recordSize(header.nlines, header.nbaselines, header.autolag, header.crosslag);
+            header.packettime = packettime;
+            generator.seed(nlines);
+            opened = true;
+            rewind();
+            return true;
+        }
+        inline void close()
+        {
+            opened = false;
+        }
+        inline void setSignal(double r, double c, double d, double a, double f)
+        {
+            rate = r;
+            correlation = c;
+            delay = d;
+            amplitude = a;
+            frequency = f;
+        }
+        inline bool isOpen() override
+        {
+            return opened;
+        }
+        inline void rewind() override
+        {
+            packets = 0;
+            started = false;
+        }
+        inline void setSpeed(double s) override
+        {
+            speed = s;
+            started = false;
+        }
+        inline int read(ahp_xc_packet *packet) override
+        {
+            if(!isOpen())
+                return -1;
+            double timestamp = packets * header.packettime;
+            if(speed > 0.0)
+            {
+                if(!started)
+                {
+                    clock.start();
+                    origin = timestamp;
+                    started = true;
+                }
+                qint64 due = (timestamp - origin) * 1000000.0 / speed;
+                qint64 now = clock.nsecsElapsed() / 1000;
+                if(due > now)
+                    QThread::usleep(due - now);
+            }
+            packet->timestamp = timestamp;
+            double mean = rate * header.packettime;
+            double fringe = 2.0 * M_PI * frequency * timestamp;
+            for(quint32 x = 0; x < header.nlines; x++)
+            {
+                double counts = mean * (1.0 + amplitude * sin(fringe + 2.0 * M_PI * x / header.nlines));
+                counts += sqrt(fmax(mean, 1.0)) * gaussian(generator);
+                packet->counts[x] = (unsigned long)fmax(0.0, counts);
+                for(quint32 lag = 0; lag < header.autolag; lag++)
+                {
+                    double magnitude = packet->counts[x] * (lag == 0 ? 1.0 : correlation * exp(-(double)lag));
+                    setCorrelation(&packet->autocorrelations[x].correlations[lag], magnitude, fringe);
+                }
+            }
+            quint32 baseline = 0;
+            double center = header.crosslag / 2;
+            for(quint32 x = 0; x < header.nlines; x++)
+            {
+                for(quint32 y = x + 1; y < header.nlines; y++, baseline++)
+                {
+                    double coherent = correlation * sqrt((double)packet->counts[x] * packet->counts[y]);
+                    double peak = center + (y - x) * delay;
+                    for(quint32 lag = 0; lag < header.crosslag; lag++)
+                    {
+                        double magnitude = coherent * exp(-0.5 * pow(lag - peak, 2));
+                        magnitude += sqrt(fmax(coherent, 1.0)) * gaussian(generator);
+                        setCorrelation(&packet->crosscorrelations[baseline].correlations[lag], fabs(magnitude), fringe * (y - x));
+                    }
+                }
+            }
+            packets++;
+            return 0;
+        }
+};
+
+#endif // EMULATOR_H
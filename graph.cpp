@@ -29,6 +29,7 @@
 #include <QTextFormat>
 #include "ahp_xc.h"
 #include "mainwindow.h"
+#include "kernels.h"
 
 Graph::Graph(QSettings *s, QWidget *parent, QString n) :
     QWidget(parent),
@@ -530,38 +531,27 @@ void Graph::paint()
     {
         if(chart == nullptr)
             return;
-        double mn = DBL_MAX;
-        double mx = DBL_MIN;
+        QPointF lo(DBL_MAX, DBL_MAX);
+        QPointF hi(-DBL_MAX, -DBL_MAX);
         for(QAbstractSeries* s : chart->series()) {
-            QXYSeries *series = (QXYSeries*)s;
-            if(series->count() == 0)
+            QXYSeries *series = qobject_cast<QXYSeries*>(s);
+            if(series == nullptr || series->count() == 0)
                 continue;
-            for(int y = 0; y < series->count(); y++)
-            {
-                mn = (mn < series->at(y).x()) ? mn : series->at(y).x();
-                mx = (mx > series->at(y).x()) ? mx : series->at(y).x();
-            }
+            QVector<QPointF> points = series->pointsVector();
+            Kernels::minmax(points.constData(), points.count(), &lo, &hi);
         }
-        if((DBL_MIN == mx && DBL_MAX == mn) || mx == mn)
+        double mn = lo.x();
+        double mx = hi.x();
+        if(DBL_MAX == mn || mx == mn)
         {
             mx = M_PI;
             mn = -M_PI;
         }
         axis_x->setRange(mn, mx);
         logaxis_x->setRange(mn, mx);
-        mn = DBL_MAX;
-        mx = DBL_MIN;
-        for(QAbstractSeries* s : chart->series()) {
-            QXYSeries *series = (QXYSeries*)s;
-            if(series->count() == 0)
-                continue;
-            for(int y = 0; y < series->count(); y++)
-            {
-                mn = (mn < series->at(y).y()) ? mn : series->at(y).y();
-                mx = (mx > series->at(y).y()) ? mx : series->at(y).y();
-            }
-        }
-        if((DBL_MIN == mx && DBL_MAX == mn) || mx == mn)
+        mn = lo.y();
+        mx = hi.y();
+        if(DBL_MAX == mn || mx == mn)
         {
             mx = M_PI;
             mn = -M_PI;
@@ -94,6 +94,10 @@ class Graph : public QWidget
         void clearSeries();
         bool threadRunning;
         void addSeries(QAbstractSeries* series, QString name);
+        inline int plotWidth()
+        {
+            return (chart != nullptr) ? (int)chart->plotArea().width() : 0;
+        }
         void setupAxes(double base_x = 1.0, double base_y = 1.0, QString title_x = "", QString title_y = "", QString format_x = "%g", QString format_y = "%g", int ticks_x = 8, int ticks_y = 8);
         void setupZAxis(QLineSeries *series, bool remove, QString title, QString format, int ticks);
         void removeSeries(QAbstractSeries* series);
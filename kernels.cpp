@@ -0,0 +1,626 @@
+/*
+   MIT License
+
+   libahp_xc library to drive the AHP XC correlators
+   Copyright (C) 2020  Ilia Platone
+
+   Permission is hereby granted, free of charge, to any person obtaining a copy
+   of this software and associated documentation files (the "Software"), to deal
+   in the Software without restriction, including without limitation the rights
+   to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+   copies of the Software, and to permit persons to whom the Software is
+   furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in all
+   copies or substantial portions of the Software.
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+   AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+   OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+
+#include <cmath>
+#include <cstring>
+#include <QtGlobal>
+#include "kernels.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define KERNELS_X86
+#include <immintrin.h>
+#if defined(__GNUC__)
+#define KERNELS_AVX2
+#define KERNELS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+static_assert(sizeof(QPointF) == 2 * sizeof(double), "QPointF must hold two doubles");
+
+typedef struct
+{
+    Kernels::Path path;
+    void (*stack)(Kernels::Stack acc, const double *buf, const double *dark, int len, double scale, double offset, double keep);
+    void (*minmax)(const double *data, int len, double *mn, double *mx);
+    void (*minmax2)(const double *xy, int count, double *mn, double *mx);
+    void (*stretch)(double *data, int len, double mn, double scale);
+    void (*stretch2)(double *xy, int count, double mn, double scale);
+} Table;
+
+static inline void kahan(double *sum, double *c, double value)
+{
+    double y = value - *c;
+    double t = *sum + y;
+    *c = (t - *sum) - y;
+    *sum = t;
+}
+
+static void stackScalar(Kernels::Stack a, const double *buf, const double *dark, int from, int len, double scale, double offset, double keep)
+{
+    for(int x = from; x < len; x++)
+    {
+        double y = buf[x] * scale + offset;
+        if(y == 0.0)
+            continue;
+        y -= dark[x];
+        double w = a.weight[x] * keep + 1.0;
+        a.weight[x] = w;
+        a.weight2[x] = a.weight2[x] * keep * keep + 1.0;
+        double delta = y - a.mean[x];
+        kahan(&a.mean[x], &a.mean_c[x], delta / w);
+        a.m2[x] *= keep;
+        a.m2_c[x] *= keep;
+        kahan(&a.m2[x], &a.m2_c[x], delta * (y - a.mean[x]));
+    }
+}
+
+static void stackScalar(Kernels::Stack a, const double *buf, const double *dark, int len, double scale, double offset, double keep)
+{
+    stackScalar(a, buf, dark, 0, len, scale, offset, keep);
+}
+
+/*
+ * The comparisons take the new value only when it compares true, like
+ * minpd/maxpd with the value first, so NaN values are skipped and the
+ * extremes do not depend on how the values are split across lanes.
+ */
+static inline void lower(double *mn, double value)
+{
+    *mn = (value < *mn) ? value : *mn;
+}
+
+static inline void upper(double *mx, double value)
+{
+    *mx = (value > *mx) ? value : *mx;
+}
+
+static void minmaxScalar(const double *data, int len, double *mn, double *mx)
+{
+    for(int x = 0; x < len; x++)
+    {
+        lower(mn, data[x]);
+        upper(mx, data[x]);
+    }
+}
+
+static void minmax2Scalar(const double *xy, int count, double *mn, double *mx)
+{
+    for(int x = 0; x < count * 2; x += 2)
+    {
+        for(int c = 0; c < 2; c++)
+        {
+            lower(&mn[c], xy[x + c]);
+            upper(&mx[c], xy[x + c]);
+        }
+    }
+}
+
+static void stretchScalar(double *data, int len, double mn, double scale)
+{
+    for(int x = 0; x < len; x++)
+        data[x] = (data[x] - mn) * scale;
+}
+
+static void stretch2Scalar(double *xy, int count, double mn, double scale)
+{
+    for(int x = 1; x < count * 2; x += 2)
+        xy[x] = (xy[x] - mn) * scale;
+}
+
+#ifdef KERNELS_X86
+static inline __m128d blend(__m128d mask, __m128d a, __m128d b)
+{
+    return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+}
+
+static inline __m128d kahan(__m128d sum, __m128d *c, __m128d value)
+{
+    __m128d y = _mm_sub_pd(value, *c);
+    __m128d t = _mm_add_pd(sum, y);
+    *c = _mm_sub_pd(_mm_sub_pd(t, sum), y);
+    return t;
+}
+
+static void stackSSE2(Kernels::Stack a, const double *buf, const double *dark, int len, double scale, double offset, double keep)
+{
+    __m128d vscale = _mm_set1_pd(scale);
+    __m128d voffset = _mm_set1_pd(offset);
+    __m128d vkeep = _mm_set1_pd(keep);
+    __m128d one = _mm_set1_pd(1.0);
+    __m128d zero = _mm_setzero_pd();
+    int x = 0;
+    for(; x + 2 <= len; x += 2)
+    {
+        __m128d y = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(buf + x), vscale), voffset);
+        __m128d mask = _mm_cmpneq_pd(y, zero);
+        if(_mm_movemask_pd(mask) == 0)
+            continue;
+        y = _mm_sub_pd(y, _mm_loadu_pd(dark + x));
+        __m128d weight = _mm_loadu_pd(a.weight + x);
+        __m128d weight2 = _mm_loadu_pd(a.weight2 + x);
+        __m128d mean = _mm_loadu_pd(a.mean + x);
+        __m128d mean_c = _mm_loadu_pd(a.mean_c + x);
+        __m128d m2 = _mm_loadu_pd(a.m2 + x);
+        __m128d m2_c = _mm_loadu_pd(a.m2_c + x);
+        __m128d w = _mm_add_pd(_mm_mul_pd(weight, vkeep), one);
+        __m128d w2 = _mm_add_pd(_mm_mul_pd(_mm_mul_pd(weight2, vkeep), vkeep), one);
+        __m128d delta = _mm_sub_pd(y, mean);
+        __m128d c = mean_c;
+        __m128d m = kahan(mean, &c, _mm_div_pd(delta, w));
+        __m128d s = _mm_mul_pd(m2, vkeep);
+        __m128d s_c = _mm_mul_pd(m2_c, vkeep);
+        s = kahan(s, &s_c, _mm_mul_pd(delta, _mm_sub_pd(y, m)));
+        _mm_storeu_pd(a.weight + x, blend(mask, w, weight));
+        _mm_storeu_pd(a.weight2 + x, blend(mask, w2, weight2));
+        _mm_storeu_pd(a.mean + x, blend(mask, m, mean));
+        _mm_storeu_pd(a.mean_c + x, blend(mask, c, mean_c));
+        _mm_storeu_pd(a.m2 + x, blend(mask, s, m2));
+        _mm_storeu_pd(a.m2_c + x, blend(mask, s_c, m2_c));
+    }
+    stackScalar(a, buf, dark, x, len, scale, offset, keep);
+}
+
+static void minmaxSSE2(const double *data, int len, double *mn, double *mx)
+{
+    __m128d vmn = _mm_set1_pd(*mn);
+    __m128d vmx = _mm_set1_pd(*mx);
+    int x = 0;
+    for(; x + 2 <= len; x += 2)
+    {
+        __m128d v = _mm_loadu_pd(data + x);
+        vmn = _mm_min_pd(v, vmn);
+        vmx = _mm_max_pd(v, vmx);
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, vmn);
+    for(int l = 0; l < 2; l++)
+        lower(mn, lanes[l]);
+    _mm_storeu_pd(lanes, vmx);
+    for(int l = 0; l < 2; l++)
+        upper(mx, lanes[l]);
+    minmaxScalar(data + x, len - x, mn, mx);
+}
+
+static void minmax2SSE2(const double *xy, int count, double *mn, double *mx)
+{
+    __m128d vmn = _mm_loadu_pd(mn);
+    __m128d vmx = _mm_loadu_pd(mx);
+    for(int x = 0; x < count * 2; x += 2)
+    {
+        __m128d v = _mm_loadu_pd(xy + x);
+        vmn = _mm_min_pd(v, vmn);
+        vmx = _mm_max_pd(v, vmx);
+    }
+    _mm_storeu_pd(mn, vmn);
+    _mm_storeu_pd(mx, vmx);
+}
+
+static void stretchSSE2(double *data, int len, double mn, double scale)
+{
+    __m128d vmn = _mm_set1_pd(mn);
+    __m128d vscale = _mm_set1_pd(scale);
+    int x = 0;
+    for(; x + 2 <= len; x += 2)
+        _mm_storeu_pd(data + x, _mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(data + x), vmn), vscale));
+    stretchScalar(data + x, len - x, mn, scale);
+}
+
+static void stretch2SSE2(double *xy, int count, double mn, double scale)
+{
+    __m128d vmn = _mm_set_pd(mn, 0.0);
+    __m128d vscale = _mm_set_pd(scale, 1.0);
+    for(int x = 0; x < count * 2; x += 2)
+        _mm_storeu_pd(xy + x, _mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(xy + x), vmn), vscale));
+}
+#endif
+
+#ifdef KERNELS_AVX2
+KERNELS_TARGET_AVX2 static inline __m256d kahan(__m256d sum, __m256d *c, __m256d value)
+{
+    __m256d y = _mm256_sub_pd(value, *c);
+    __m256d t = _mm256_add_pd(sum, y);
+    *c = _mm256_sub_pd(_mm256_sub_pd(t, sum), y);
+    return t;
+}
+
+KERNELS_TARGET_AVX2 static void stackAVX2(Kernels::Stack a, const double *buf, const double *dark, int len, double scale, double offset, double keep)
+{
+    __m256d vscale = _mm256_set1_pd(scale);
+    __m256d voffset = _mm256_set1_pd(offset);
+    __m256d vkeep = _mm256_set1_pd(keep);
+    __m256d one = _mm256_set1_pd(1.0);
+    __m256d zero = _mm256_setzero_pd();
+    int x = 0;
+    for(; x + 4 <= len; x += 4)
+    {
+        __m256d y = _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(buf + x), vscale), voffset);
+        __m256d mask = _mm256_cmp_pd(y, zero, _CMP_NEQ_UQ);
+        if(_mm256_movemask_pd(mask) == 0)
+            continue;
+        y = _mm256_sub_pd(y, _mm256_loadu_pd(dark + x));
+        __m256d weight = _mm256_loadu_pd(a.weight + x);
+        __m256d weight2 = _mm256_loadu_pd(a.weight2 + x);
+        __m256d mean = _mm256_loadu_pd(a.mean + x);
+        __m256d mean_c = _mm256_loadu_pd(a.mean_c + x);
+        __m256d m2 = _mm256_loadu_pd(a.m2 + x);
+        __m256d m2_c = _mm256_loadu_pd(a.m2_c + x);
+        __m256d w = _mm256_add_pd(_mm256_mul_pd(weight, vkeep), one);
+        __m256d w2 = _mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(weight2, vkeep), vkeep), one);
+        __m256d delta = _mm256_sub_pd(y, mean);
+        __m256d c = mean_c;
+        __m256d m = kahan(mean, &c, _mm256_div_pd(delta, w));
+        __m256d s = _mm256_mul_pd(m2, vkeep);
+        __m256d s_c = _mm256_mul_pd(m2_c, vkeep);
+        s = kahan(s, &s_c, _mm256_mul_pd(delta, _mm256_sub_pd(y, m)));
+        _mm256_storeu_pd(a.weight + x, _mm256_blendv_pd(weight, w, mask));
+        _mm256_storeu_pd(a.weight2 + x, _mm256_blendv_pd(weight2, w2, mask));
+        _mm256_storeu_pd(a.mean + x, _mm256_blendv_pd(mean, m, mask));
+        _mm256_storeu_pd(a.mean_c + x, _mm256_blendv_pd(mean_c, c, mask));
+        _mm256_storeu_pd(a.m2 + x, _mm256_blendv_pd(m2, s, mask));
+        _mm256_storeu_pd(a.m2_c + x, _mm256_blendv_pd(m2_c, s_c, mask));
+    }
+    stackScalar(a, buf, dark, x, len, scale, offset, keep);
+}
+
+KERNELS_TARGET_AVX2 static void minmaxAVX2(const double *data, int len, double *mn, double *mx)
+{
+    __m256d vmn = _mm256_set1_pd(*mn);
+    __m256d vmx = _mm256_set1_pd(*mx);
+    int x = 0;
+    for(; x + 4 <= len; x += 4)
+    {
+        __m256d v = _mm256_loadu_pd(data + x);
+        vmn = _mm256_min_pd(v, vmn);
+        vmx = _mm256_max_pd(v, vmx);
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, vmn);
+    for(int l = 0; l < 4; l++)
+        lower(mn, lanes[l]);
+    _mm256_storeu_pd(lanes, vmx);
+    for(int l = 0; l < 4; l++)
+        upper(mx, lanes[l]);
+    minmaxScalar(data + x, len - x, mn, mx);
+}
+
+KERNELS_TARGET_AVX2 static void minmax2AVX2(const double *xy, int count, double *mn, double *mx)
+{
+    __m256d vmn = _mm256_broadcast_pd((const __m128d*)mn);
+    __m256d vmx = _mm256_broadcast_pd((const __m128d*)mx);
+    int x = 0;
+    for(; x + 4 <= count * 2; x += 4)
+    {
+        __m256d v = _mm256_loadu_pd(xy + x);
+        vmn = _mm256_min_pd(v, vmn);
+        vmx = _mm256_max_pd(v, vmx);
+    }
+    __m128d lo = _mm_min_pd(_mm256_extractf128_pd(vmn, 1), _mm256_castpd256_pd128(vmn));
+    __m128d hi = _mm_max_pd(_mm256_extractf128_pd(vmx, 1), _mm256_castpd256_pd128(vmx));
+    _mm_storeu_pd(mn, lo);
+    _mm_storeu_pd(mx, hi);
+    minmax2Scalar(xy + x, count - x / 2, mn, mx);
+}
+
+KERNELS_TARGET_AVX2 static void stretchAVX2(double *data, int len, double mn, double scale)
+{
+    __m256d vmn = _mm256_set1_pd(mn);
+    __m256d vscale = _mm256_set1_pd(scale);
+    int x = 0;
+    for(; x + 4 <= len; x += 4)
+        _mm256_storeu_pd(data + x, _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(data + x), vmn), vscale));
+    stretchScalar(data + x, len - x, mn, scale);
+}
+
+KERNELS_TARGET_AVX2 static void stretch2AVX2(double *xy, int count, double mn, double scale)
+{
+    __m256d vmn = _mm256_set_pd(mn, 0.0, mn, 0.0);
+    __m256d vscale = _mm256_set_pd(scale, 1.0, scale, 1.0);
+    int x = 0;
+    for(; x + 4 <= count * 2; x += 4)
+        _mm256_storeu_pd(xy + x, _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(xy + x), vmn), vscale));
+    stretch2Scalar(xy + x, count - x / 2, mn, scale);
+}
+#endif
+
+#ifdef KERNELS_NEON
+static inline float64x2_t kahan(float64x2_t sum, float64x2_t *c, float64x2_t value)
+{
+    float64x2_t y = vsubq_f64(value, *c);
+    float64x2_t t = vaddq_f64(sum, y);
+    *c = vsubq_f64(vsubq_f64(t, sum), y);
+    return t;
+}
+
+static void stackNEON(Kernels::Stack a, const double *buf, const double *dark, int len, double scale, double offset, double keep)
+{
+    float64x2_t vscale = vdupq_n_f64(scale);
+    float64x2_t voffset = vdupq_n_f64(offset);
+    float64x2_t vkeep = vdupq_n_f64(keep);
+    float64x2_t one = vdupq_n_f64(1.0);
+    float64x2_t zero = vdupq_n_f64(0.0);
+    int x = 0;
+    for(; x + 2 <= len; x += 2)
+    {
+        float64x2_t y = vaddq_f64(vmulq_f64(vld1q_f64(buf + x), vscale), voffset);
+        uint64x2_t skip = vceqq_f64(y, zero);
+        if(vgetq_lane_u64(skip, 0) && vgetq_lane_u64(skip, 1))
+            continue;
+        y = vsubq_f64(y, vld1q_f64(dark + x));
+        float64x2_t weight = vld1q_f64(a.weight + x);
+        float64x2_t weight2 = vld1q_f64(a.weight2 + x);
+        float64x2_t mean = vld1q_f64(a.mean + x);
+        float64x2_t mean_c = vld1q_f64(a.mean_c + x);
+        float64x2_t m2 = vld1q_f64(a.m2 + x);
+        float64x2_t m2_c = vld1q_f64(a.m2_c + x);
+        float64x2_t w = vaddq_f64(vmulq_f64(weight, vkeep), one);
+        float64x2_t w2 = vaddq_f64(vmulq_f64(vmulq_f64(weight2, vkeep), vkeep), one);
+        float64x2_t delta = vsubq_f64(y, mean);
+        float64x2_t c = mean_c;
+        float64x2_t m = kahan(mean, &c, vdivq_f64(delta, w));
+        float64x2_t s = vmulq_f64(m2, vkeep);
+        float64x2_t s_c = vmulq_f64(m2_c, vkeep);
+        s = kahan(s, &s_c, vmulq_f64(delta, vsubq_f64(y, m)));
+        vst1q_f64(a.weight + x, vbslq_f64(skip, weight, w));
+        vst1q_f64(a.weight2 + x, vbslq_f64(skip, weight2, w2));
+        vst1q_f64(a.mean + x, vbslq_f64(skip, mean, m));
+        vst1q_f64(a.mean_c + x, vbslq_f64(skip, mean_c, c));
+        vst1q_f64(a.m2 + x, vbslq_f64(skip, m2, s));
+        vst1q_f64(a.m2_c + x, vbslq_f64(skip, m2_c, s_c));
+    }
+    stackScalar(a, buf, dark, x, len, scale, offset, keep);
+}
+
+static inline float64x2_t minimum(float64x2_t a, float64x2_t b)
+{
+    return vbslq_f64(vcltq_f64(a, b), a, b);
+}
+
+static inline float64x2_t maximum(float64x2_t a, float64x2_t b)
+{
+    return vbslq_f64(vcgtq_f64(a, b), a, b);
+}
+
+static void minmaxNEON(const double *data, int len, double *mn, double *mx)
+{
+    float64x2_t vmn = vdupq_n_f64(*mn);
+    float64x2_t vmx = vdupq_n_f64(*mx);
+    int x = 0;
+    for(; x + 2 <= len; x += 2)
+    {
+        float64x2_t v = vld1q_f64(data + x);
+        vmn = minimum(v, vmn);
+        vmx = maximum(v, vmx);
+    }
+    double lanes[2];
+    vst1q_f64(lanes, vmn);
+    for(int l = 0; l < 2; l++)
+        lower(mn, lanes[l]);
+    vst1q_f64(lanes, vmx);
+    for(int l = 0; l < 2; l++)
+        upper(mx, lanes[l]);
+    minmaxScalar(data + x, len - x, mn, mx);
+}
+
+static void minmax2NEON(const double *xy, int count, double *mn, double *mx)
+{
+    float64x2_t vmn = vld1q_f64(mn);
+    float64x2_t vmx = vld1q_f64(mx);
+    for(int x = 0; x < count * 2; x += 2)
+    {
+        float64x2_t v = vld1q_f64(xy + x);
+        vmn = minimum(v, vmn);
+        vmx = maximum(v, vmx);
+    }
+    vst1q_f64(mn, vmn);
+    vst1q_f64(mx, vmx);
+}
+
+static void stretchNEON(double *data, int len, double mn, double scale)
+{
+    float64x2_t vmn = vdupq_n_f64(mn);
+    float64x2_t vscale = vdupq_n_f64(scale);
+    int x = 0;
+    for(; x + 2 <= len; x += 2)
+        vst1q_f64(data + x, vmulq_f64(vsubq_f64(vld1q_f64(data + x), vmn), vscale));
+    stretchScalar(data + x, len - x, mn, scale);
+}
+
+static void stretch2NEON(double *xy, int count, double mn, double scale)
+{
+    const double offsets[2] = { 0.0, mn };
+    const double scales[2] = { 1.0, scale };
+    float64x2_t vmn = vld1q_f64(offsets);
+    float64x2_t vscale = vld1q_f64(scales);
+    for(int x = 0; x < count * 2; x += 2)
+        vst1q_f64(xy + x, vmulq_f64(vsubq_f64(vld1q_f64(xy + x), vmn), vscale));
+}
+#endif
+
+static const Table scalarTable = { Kernels::Scalar, stackScalar, minmaxScalar, minmax2Scalar, stretchScalar, stretch2Scalar };
+#ifdef KERNELS_X86
+static const Table sse2Table = { Kernels::SSE2, stackSSE2, minmaxSSE2, minmax2SSE2, stretchSSE2, stretch2SSE2 };
+#endif
+#ifdef KERNELS_AVX2
+static const Table avx2Table = { Kernels::AVX2, stackAVX2, minmaxAVX2, minmax2AVX2, stretchAVX2, stretch2AVX2 };
+#endif
+#ifdef KERNELS_NEON
+static const Table neonTable = { Kernels::NEON, stackNEON, minmaxNEON, minmax2NEON, stretchNEON, stretch2NEON };
+#endif
+
+// the paths this build and CPU can run, narrowest first
+static int tables(const Table **list)
+{
+    int count = 0;
+    list[count++] = &scalarTable;
+#ifdef KERNELS_X86
+    list[count++] = &sse2Table;
+#endif
+#ifdef KERNELS_AVX2
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+        list[count++] = &avx2Table;
+#endif
+#ifdef KERNELS_NEON
+    list[count++] = &neonTable;
+#endif
+    return count;
+}
+
+static const Table &table()
+{
+    static const Table *list[4];
+    static const Table &t = *list[tables(list) - 1];
+#ifndef QT_NO_DEBUG
+    static const bool agree = Kernels::selfTest();
+    Q_ASSERT(agree);
+#endif
+    return t;
+}
+
+static inline bool same(const double *a, const double *b, int len)
+{
+    for(int x = 0; x < len; x++)
+    {
+        if(std::isnan(a[x]) && std::isnan(b[x]))
+            continue;
+        if(memcmp(&a[x], &b[x], sizeof(double)))
+            return false;
+    }
+    return true;
+}
+
+bool Kernels::selfTest()
+{
+    // odd length so every vector path also runs its scalar tail
+    const int len = 37;
+    double data[len];
+    double dark[len];
+    for(int x = 0; x < len; x++)
+    {
+        if(x % 7 == 3)
+            data[x] = NAN;
+        else if(x % 5 == 0)
+            data[x] = (x & 1) ? -0.0 : 0.0;
+        else
+            data[x] = sin(x) * 100.0;
+        dark[x] = cos(x);
+    }
+    const Table *list[4];
+    int count = tables(list);
+    const Table *ref = list[0];
+    for(int p = 1; p < count; p++)
+    {
+        const Table *t = list[p];
+        double lo[2] = { 1.0, NAN };
+        double hi[2] = { -1.0, NAN };
+        double vlo[2] = { 1.0, NAN };
+        double vhi[2] = { -1.0, NAN };
+        ref->minmax(data, len, &lo[0], &hi[0]);
+        t->minmax(data, len, &vlo[0], &vhi[0]);
+        ref->minmax2(data, len / 2, &lo[0], &hi[0]);
+        t->minmax2(data, len / 2, &vlo[0], &vhi[0]);
+        for(int c = 0; c < 2; c++)
+        {
+            lo[c] += 0.0;
+            hi[c] += 0.0;
+            vlo[c] += 0.0;
+            vhi[c] += 0.0;
+        }
+        if(!same(lo, vlo, 2) || !same(hi, vhi, 2))
+            return false;
+        double a[len];
+        double b[len];
+        memcpy(a, data, sizeof(a));
+        memcpy(b, data, sizeof(b));
+        ref->stretch(a, len, -100.0, 0.03);
+        t->stretch(b, len, -100.0, 0.03);
+        ref->stretch2(a, len / 2, 1.0, 7.0);
+        t->stretch2(b, len / 2, 1.0, 7.0);
+        if(!same(a, b, len))
+            return false;
+        double acc[2][6][len];
+        memset(acc, 0, sizeof(acc));
+        Stack s[2];
+        for(int k = 0; k < 2; k++)
+            s[k] = { acc[k][0], acc[k][1], acc[k][2], acc[k][3], acc[k][4], acc[k][5] };
+        for(int pass = 0; pass < 3; pass++)
+        {
+            ref->stack(s[0], data, dark, len, 1.5, 0.25 * pass, 0.9);
+            t->stack(s[1], data, dark, len, 1.5, 0.25 * pass, 0.9);
+        }
+        for(int k = 0; k < 6; k++)
+        {
+            if(!same(acc[0][k], acc[1][k], len))
+                return false;
+        }
+    }
+    return true;
+}
+
+Kernels::Path Kernels::path()
+{
+    return table().path;
+}
+
+const char *Kernels::pathName()
+{
+    static const char *names[] = { "scalar", "SSE2", "AVX2", "NEON" };
+    return names[path()];
+}
+
+void Kernels::stack(Stack acc, const double *buf, const double *dark, int len, double scale, double offset, double keep)
+{
+    table().stack(acc, buf, dark, len, scale, offset, keep);
+}
+
+void Kernels::minmax(const QPointF *points, int count, QPointF *mn, QPointF *mx)
+{
+    double lo[2] = { mn->x(), mn->y() };
+    double hi[2] = { mx->x(), mx->y() };
+    table().minmax2((const double*)points, count, lo, hi);
+    // equal zeros of either sign may win depending on the lanes, return +0
+    *mn = QPointF(lo[0] + 0.0, lo[1] + 0.0);
+    *mx = QPointF(hi[0] + 0.0, hi[1] + 0.0);
+}
+
+void Kernels::minmax(const double *data, int len, double *mn, double *mx)
+{
+    table().minmax(data, len, mn, mx);
+    *mn += 0.0;
+    *mx += 0.0;
+}
+
+void Kernels::stretch(QPointF *points, int count, double mn, double mx, double range)
+{
+    table().stretch2((double*)points, count, mn, range / (mx - mn));
+}
+
+void Kernels::stretch(double *data, int len, double mn, double mx, double range)
+{
+    table().stretch(data, len, mn, range / (mx - mn));
+}
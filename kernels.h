@@ -0,0 +1,76 @@
+/*
+    MIT License
+
+    xc-gui GUI for libahp_xc and OpenVLBI using the AHP XC correlators
+    Copyright (C) 2020  Ilia Platone
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <QPointF>
+
+/*
+ * Vector kernels of the spectrum and chart loops.
+ * Every kernel has a scalar version and AVX2, SSE2 or NEON versions, the
+ * widest one the CPU supports is picked on first use. Vector versions run
+ * the same operations in the same order per element as the scalar one,
+ * so the path does not change the results.
+ */
+class Kernels
+{
+    public:
+        enum Path
+        {
+            Scalar = 0,
+            SSE2,
+            AVX2,
+            NEON
+        };
+        // the arrays of an Accumulator, one element per lag
+        typedef struct
+        {
+            double *weight;
+            double *weight2;
+            double *mean;
+            double *mean_c;
+            double *m2;
+            double *m2_c;
+        } Stack;
+
+        static Path path();
+        static const char *pathName();
+        // runs every path available here against the scalar one, debug builds check it on first use
+        static bool selfTest();
+        /*
+         * y = buf * scale + offset, lags where y is not zero get y - dark
+         * added to their Welford accumulator, keep is 1 - decay.
+         */
+        static void stack(Stack acc, const double *buf, const double *dark, int len, double scale, double offset, double keep);
+        // widens mn and mx, component wise for points, to cover the values, NaN values are skipped
+        static void minmax(const QPointF *points, int count, QPointF *mn, QPointF *mx);
+        static void minmax(const double *data, int len, double *mn, double *mx);
+        // maps the y values from [mn, mx] onto [0, range]
+        static void stretch(QPointF *points, int count, double mn, double mx, double range);
+        static void stretch(double *data, int len, double mn, double mx, double range);
+};
+
+#endif // KERNELS_H
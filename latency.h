@@ -0,0 +1,229 @@
+/*
+    MIT License
+
+    xc-gui GUI for libahp_xc and OpenVLBI using the AHP XC correlators
+    Copyright (C) 2020  Ilia Platone
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <atomic>
+#include <chrono>
+#include <QFile>
+#include <QString>
+#include <QTextStream>
+
+#define LATENCY_SUBBUCKETS 8
+#define LATENCY_BUCKETS (62 * LATENCY_SUBBUCKETS)
+
+/*
+ * Per stage latency histograms of the packet path.
+ * Each stage records the time elapsed since an origin, usually the
+ * moment its packet was read from the device. Buckets are log-linear,
+ * 8 per power of two, so percentiles are exact within 12.5%. Recording
+ * is lock free and may happen from any thread.
+ * The packet thread sets the origin of the batch being dispatched with
+ * setOrigin() and hands it to the UI with publish(), the UI takes it
+ * back with take() when it paints the frame showing that batch.
+ */
+class Latency
+{
+    public:
+        enum Stage
+        {
+            Read = 0,
+            Dispatch,
+            SeriesAdd,
+            Histogram,
+            Paint,
+            Present,
+            Stages
+        };
+
+    private:
+        typedef struct
+        {
+            std::atomic<quint64> buckets[LATENCY_BUCKETS];
+            std::atomic<quint64> count;
+            std::atomic<qint64> max;
+        } histogram;
+        static inline histogram *histograms()
+        {
+            static histogram h[Stages];
+            return h;
+        }
+        static inline std::atomic<qint64> *current()
+        {
+            static std::atomic<qint64> origin { 0 };
+            return &origin;
+        }
+        static inline std::atomic<qint64> *published()
+        {
+            static std::atomic<qint64> origin { 0 };
+            return &origin;
+        }
+        static inline int bucket(quint64 ns)
+        {
+            if(ns < LATENCY_SUBBUCKETS)
+                return ns;
+            int msb = 63 - __builtin_clzll(ns);
+            return (msb - 2) * LATENCY_SUBBUCKETS + ((ns >> (msb - 3)) & (LATENCY_SUBBUCKETS - 1));
+        }
+        static inline quint64 bucketValue(int index)
+        {
+            if(index < LATENCY_SUBBUCKETS)
+                return index;
+            int msb = index / LATENCY_SUBBUCKETS + 2;
+            quint64 sub = index % LATENCY_SUBBUCKETS;
+            return ((LATENCY_SUBBUCKETS + sub) << (msb - 3)) + ((1ull << (msb - 3)) >> 1);
+        }
+
+    public:
+        static inline qint64 now()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+        static inline QString stageName(Stage stage)
+        {
+            switch(stage)
+            {
+                case Read: return "read";
+                case Dispatch: return "dispatch";
+                case SeriesAdd: return "series";
+                case Histogram: return "histogram";
+                case Paint: return "paint";
+                case Present: return "present";
+                default: return "";
+            }
+        }
+        static inline void record(Stage stage, qint64 origin)
+        {
+            if(origin <= 0)
+                return;
+            qint64 ns = now() - origin;
+            if(ns < 0)
+                ns = 0;
+            histogram *h = &histograms()[stage];
+            h->buckets[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+            h->count.fetch_add(1, std::memory_order_relaxed);
+            qint64 max = h->max.load(std::memory_order_relaxed);
+            while(ns > max && !h->max.compare_exchange_weak(max, ns, std::memory_order_relaxed));
+        }
+        static inline void setOrigin(qint64 origin)
+        {
+            current()->store(origin, std::memory_order_relaxed);
+        }
+        static inline qint64 origin()
+        {
+            return current()->load(std::memory_order_relaxed);
+        }
+        static inline void publish(qint64 origin)
+        {
+            qint64 expected = 0;
+            published()->compare_exchange_strong(expected, origin, std::memory_order_relaxed);
+        }
+        static inline qint64 take()
+        {
+            return published()->exchange(0, std::memory_order_relaxed);
+        }
+        static inline quint64 count(Stage stage)
+        {
+            return histograms()[stage].count.load(std::memory_order_relaxed);
+        }
+        static inline qint64 max(Stage stage)
+        {
+            return histograms()[stage].max.load(std::memory_order_relaxed);
+        }
+        static inline qint64 percentile(Stage stage, double p)
+        {
+            histogram *h = &histograms()[stage];
+            quint64 total = h->count.load(std::memory_order_relaxed);
+            if(total == 0)
+                return 0;
+            quint64 rank = (quint64)(p * (total - 1) / 100.0) + 1;
+            quint64 seen = 0;
+            for(int x = 0; x < LATENCY_BUCKETS; x++)
+            {
+                seen += h->buckets[x].load(std::memory_order_relaxed);
+                if(seen >= rank)
+                    return qMin((qint64)bucketValue(x), max(stage));
+            }
+            return max(stage);
+        }
+        static inline void reset()
+        {
+            for(int s = 0; s < Stages; s++)
+            {
+                histogram *h = &histograms()[s];
+                for(int x = 0; x < LATENCY_BUCKETS; x++)
+                    h->buckets[x].store(0, std::memory_order_relaxed);
+                h->count.store(0, std::memory_order_relaxed);
+                h->max.store(0, std::memory_order_relaxed);
+            }
+            setOrigin(0);
+            take();
+        }
+        static inline QString summary()
+        {
+            QString text = "Latency (us, p50/p99/max):";
+            for(int s = 0; s < Stages; s++)
+            {
+                Stage stage = (Stage)s;
+                if(count(stage) == 0)
+                    continue;
+                text += QString(" %1 %2/%3/%4").arg(stageName(stage))
+                        .arg(percentile(stage, 50) / 1000.0, 0, 'f', 1)
+                        .arg(percentile(stage, 99) / 1000.0, 0, 'f', 1)
+                        .arg(max(stage) / 1000.0, 0, 'f', 1);
+            }
+            return text;
+        }
+        static inline bool dump(QString filename)
+        {
+            QFile file(filename);
+            if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+                return false;
+            QTextStream out(&file);
+            out << "stage,count,p50_ns,p90_ns,p99_ns,p999_ns,max_ns\n";
+            for(int s = 0; s < Stages; s++)
+            {
+                Stage stage = (Stage)s;
+                out << stageName(stage) << "," << count(stage) << "," << percentile(stage, 50) << "," << percentile(stage, 90) << ","
+                    << percentile(stage, 99) << "," << percentile(stage, 99.9) << "," << max(stage) << "\n";
+            }
+            out << "\nstage,bucket_ns,count\n";
+            for(int s = 0; s < Stages; s++)
+            {
+                histogram *h = &histograms()[s];
+                for(int x = 0; x < LATENCY_BUCKETS; x++)
+                {
+                    quint64 n = h->buckets[x].load(std::memory_order_relaxed);
+                    if(n > 0)
+                        out << stageName((Stage)s) << "," << bucketValue(x) << "," << n << "\n";
+                }
+            }
+            file.close();
+            return true;
+        }
+};
+
+#endif // LATENCY_H
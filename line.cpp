@@ -52,6 +52,7 @@ Line::Line(QString ln, int n, QSettings *s, QWidget *pw, QList<Line*> *p) :
     spectrum = new Series();
     counts = new Series();
     connect(getSpectrum()->getElemental(), static_cast<void (Elemental::*)(bool, double, double)>(&Elemental::scanFinished), this, &Line::plot);
+    connect(getSpectrum()->getElemental(), static_cast<void (Elemental::*)(bool, double, double)>(&Elemental::scanFinished), this, &Line::showRanking);
     resetPercentPtr();
     resetStopPtr();
     getSpectrum()->setName(name + " spectrum");
@@ -59,7 +60,7 @@ Line::Line(QString ln, int n, QSettings *s, QWidget *pw, QList<Line*> *p) :
     stream = dsp_stream_new();
     dsp_stream_add_dim(stream, 1);
     dsp_stream_alloc_buffer(stream, stream->len);
-    stream->samplerate = 1.0/ahp_xc_get_packettime();
+    setPacketTime(ahp_xc_get_packettime());
     line = n;
     flags = (1 << 3);
     QStandardItemModel *model = new QStandardItemModel();
@@ -97,6 +98,7 @@ Line::Line(QString ln, int n, QSettings *s, QWidget *pw, QList<Line*> *p) :
                     }
                     element = cat.readLine().replace(".txt\n", "");
                 }
+                rows.insert(catname, fileInfo.dir().path()+dir_separator+catname+dir_separator+"index.txt");
                 catalog->setData("");
                 catalog->setEditable(false);
                 model->insertRow(ncatalogs++, catalog);
@@ -119,6 +121,19 @@ Line::Line(QString ln, int n, QSettings *s, QWidget *pw, QList<Line*> *p) :
         QString catalog = index.parent().data().toString();
         if(!catalog.isEmpty())
             getSpectrum()->getElemental()->loadSpectrum(rows[catalog+dir_separator+index.data().toString()]);
+        else
+            getSpectrum()->getElemental()->loadCatalog(rows[index.data().toString()]);
+    });
+    connect(getSpectrum()->getElemental(), static_cast<void (Elemental::*)(QString, int)>(&Elemental::elementMatched), this, [ = ] (QString element, int rank)
+    {
+        QStandardItemModel *model = (QStandardItemModel*)ui->Catalogs->model();
+        if(model == nullptr)
+            return;
+        for(QStandardItem *item : model->findItems(element, Qt::MatchExactly | Qt::MatchRecursive))
+        {
+            if(item->parent() != nullptr)
+                markMatch(item, rank);
+        }
     });
     connect(ui->flag0, static_cast<void (QCheckBox::*)(bool)>(&QCheckBox::clicked), [ = ](bool checked)
     {
@@ -195,6 +210,7 @@ Line::Line(QString ln, int n, QSettings *s, QWidget *pw, QList<Line*> *p) :
         ui->Decimals->setEnabled(ui->ElementalAlign->isChecked());
         ui->MinScore->setEnabled(ui->ElementalAlign->isChecked());
         ui->SampleSize->setEnabled(ui->ElementalAlign->isChecked());
+        ui->TopMatches->setEnabled(ui->ElementalAlign->isChecked());
     });
     connect(ui->Resolution, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), [ = ](int value)
     {
@@ -233,6 +249,11 @@ Line::Line(QString ln, int n, QSettings *s, QWidget *pw, QList<Line*> *p) :
         getSpectrum()->getElemental()->setSampleSize(value);
         SaveValues();
     });
+    connect(ui->TopMatches, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), [ = ](int value)
+    {
+        getSpectrum()->getElemental()->setTopMatches(value);
+        SaveValues();
+    });
     connect(ui->StartChannel, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), [ = ](int value)
     {
         if(ui->StartChannel->value() > ui->EndChannel->value() - 2)
@@ -370,6 +391,10 @@ void Line::Initialize()
     ui->Decimals->setValue(readInt("Decimals", 0));
     ui->MaxDots->setValue(readInt("MaxDots", 10));
     ui->SampleSize->setValue(readInt("SampleSize", 5));
+    ui->TopMatches->setValue(readInt("TopMatches", 5));
+    getSpectrum()->setDecay(readDouble("StackDecay", 0.0));
+    getCounts()->setMemoryBudget(readDouble("MemoryBudget", SERIES_MEMORY_BUDGET));
+    getCounts()->setDiskBudget(readDouble("DiskBudget", SERIES_DISK_BUDGET));
     ui->Resolution->setRange(1000000000.0 * ahp_xc_get_sampletime(), ahp_xc_get_delaysize() * 1000000000.0 * ahp_xc_get_sampletime());
     ui->Resolution->setValue(readInt("Resolution", 100));
     ui->AutoChannel->setValue(readInt("AutoChannel", ui->AutoChannel->maximum()));
@@ -511,7 +536,11 @@ void Line::addCount(double starttime, ahp_xc_packet *p)
 {
     if(p == nullptr)
         p = getPacket();
-    setLocation();
+    addCount(starttime, &p, 1);
+}
+
+void Line::addCount(double starttime, ahp_xc_packet **packets, size_t npackets)
+{
     switch(getMode()) {
         default: break;
         case HolographIQ:
@@ -520,29 +549,33 @@ void Line::addCount(double starttime, ahp_xc_packet *p)
         case Counter:
         if(isActive())
         {
-            double mag = -1.0;
-            double phi = -1.0;
-            double counts = -1.0;
-            if(showCounts()) {
-                counts = (double)packet->counts[getLineIndex()] / ahp_xc_get_packettime();
-            }
-            if(showAutocorrelations()) {
-                mag = (double)packet->autocorrelations[getLineIndex()].correlations[0].magnitude / ahp_xc_get_packettime(),
-                phi = (double)packet->autocorrelations[getLineIndex()].correlations[0].phase;
-            }
-            getCounts()->addCount(
-                        packet->timestamp + starttime - getTimeRange(),
-                        packet->timestamp + starttime,
-                        counts,
-                        mag,
-                        phi
-            );
-            if(showCountHistogram()) {
-                getCounts()->buildHistogram(getCounts()->getSeries(), getCounts()->getElemental()->getStream(), getResolution(), getCounts()->getHistogramStackIndex(), getCounts()->getHistogramStack(), getCounts()->getHistogram());
-            }
-            if(showCorrelationsHistogram()) {
-                getCounts()->buildHistogram(getCounts()->getMagnitude(), getCounts()->getElemental()->getStream()->magnitude, getResolution(), getCounts()->getHistogramStackIndexMagnitude(), getCounts()->getHistogramStackMagnitude(), getCounts()->getHistogramMagnitude());
+            bool show_counts = showCounts();
+            bool show_autocorrelations = showAutocorrelations();
+            double packettime = getPacketTime();
+            for(size_t n = 0; n < npackets; n++)
+            {
+                ahp_xc_packet *p = packets[n];
+                double mag = -1.0;
+                double phi = -1.0;
+                double counts = -1.0;
+                if(show_counts) {
+                    counts = (double)p->counts[getLineIndex()] / packettime;
+                }
+                if(show_autocorrelations) {
+                    mag = (double)p->autocorrelations[getLineIndex()].correlations[0].magnitude / packettime,
+                    phi = (double)p->autocorrelations[getLineIndex()].correlations[0].phase;
+                }
+                getCounts()->addCount(
+                            p->timestamp + starttime - getTimeRange(),
+                            p->timestamp + starttime,
+                            counts,
+                            mag,
+                            phi
+                );
             }
+            getCounts()->setHistogram(getResolution(), showCountHistogram(), showCorrelationsHistogram());
+            if(showCountHistogram() || showCorrelationsHistogram())
+                Latency::record(Latency::Histogram, Latency::origin());
         }
         else
         {
@@ -667,6 +700,7 @@ void Line::SaveValues()
     settings->setValue("Decimals", ui->Decimals->value());
     settings->setValue("MinScore", ui->MinScore->value());
     settings->setValue("SampleSize", ui->SampleSize->value());
+    settings->setValue("TopMatches", ui->TopMatches->value());
     settings->setValue("darkstring", darkstring);
 }
 
@@ -694,6 +728,7 @@ void Line::ReadValues()
     ui->Decimals->setValue(settings->value("Decimals", 0).toInt());
     ui->MinScore->setValue(settings->value("MinScore", 0).toInt());
     ui->SampleSize->setValue(settings->value("SampleSize", 0).toInt());
+    ui->TopMatches->setValue(settings->value("TopMatches", 5).toInt());
     darkstring = QString(QByteArray::fromBase64(settings->value("darkstring", "").toByteArray()));
 }
 
@@ -819,7 +854,7 @@ bool Line::showCrosscorrelations()
 
 void Line::setMode(Mode m)
 {
-    getDark()->clear();
+    getSpectrum()->clearDark();
     getSpectrum()->clear();
     getCounts()->clear();
     ui->flag0->setEnabled(ahp_xc_has_leds());
@@ -892,6 +927,10 @@ void Line::setMode(Mode m)
 
 void Line::paint()
 {
+    getCounts()->publish();
+    getSpectrum()->publish();
+    if(isActive())
+        showStatistics();
     *stop = !isActive();
     if(ui->Progress != nullptr)
     {
@@ -904,6 +943,60 @@ void Line::paint()
     update(rect());
 }
 
+void Line::showStatistics()
+{
+    QString text;
+    QStringList names = { "Counts", "Magnitude", "Phase" };
+    Columns *columns = getCounts()->getColumns();
+    columns->lock();
+    for(int c = 0; c < Series::ColumnCount; c++)
+    {
+        Statistics *channel = getCounts()->getStatistics(c);
+        if(channel->count() == 0)
+            continue;
+        text += names[c] + ": mean " + QString::number(channel->getMean(), 'g', 4) + " rms " + QString::number(channel->getRMS(), 'g', 4)
+                + " min " + QString::number(channel->getMin(), 'g', 4) + " max " + QString::number(channel->getMax(), 'g', 4) + "\n";
+    }
+    Statistics *counts = getCounts()->getStatistics(Series::CountsColumn);
+    if(counts->octaves() > 0)
+        text += "Allan deviation (counts):";
+    for(int l = 0; l < counts->octaves(); l++)
+        text += QString(l % 3 ? "  " : "\n") + QString::number(counts->getTau(l), 'g', 3) + "s " + QString::number(counts->getAllanDeviation(l), 'g', 3);
+    columns->unlock();
+    ui->StatisticsValues->setText(text);
+}
+
+void Line::markMatch(QStandardItem *item, int rank, bool unconfirmed)
+{
+    QFont font = item->font();
+    font.setBold(rank >= 0);
+    font.setItalic(unconfirmed);
+    item->setFont(font);
+    item->setToolTip(rank >= 0 ? "Match #" + QString::number(rank + 1) : (unconfirmed ? "Unconfirmed line index fit" : ""));
+}
+
+void Line::showRanking()
+{
+    QStandardItemModel *model = (QStandardItemModel*)ui->Catalogs->model();
+    if(model == nullptr)
+        return;
+    QStringList ranking = getSpectrum()->getElemental()->getRanking();
+    QString unconfirmed = getSpectrum()->getElemental()->getUnconfirmed();
+    for(int c = 0; c < model->rowCount(); c++)
+    {
+        QStandardItem *catalog = model->item(c);
+        for(int e = 0; e < catalog->rowCount(); e++)
+        {
+            QString name = catalog->child(e)->text();
+            markMatch(catalog->child(e), ranking.indexOf(name), !unconfirmed.isEmpty() && name == unconfirmed);
+        }
+    }
+    QString best = ranking.isEmpty() && !unconfirmed.isEmpty() ? unconfirmed + " (unconfirmed)" : ranking.join(", ");
+    ui->Catalogs->setToolTip("Best: " + best + "\nAligned in " +
+                             QString::number(getSpectrum()->getElemental()->getAlignTime() / 1000000.0, 'f', 1) + " ms after " +
+                             QString::number(getSpectrum()->getElemental()->getAlignWait() / 1000000.0, 'f', 1) + " ms queued");
+}
+
 void Line::addToVLBIContext()
 {
     while(!MainWindow::lock_vlbi());
@@ -922,22 +1015,6 @@ void Line::removeFromVLBIContext()
     MainWindow::unlock_vlbi();
 }
 
-void Line::stretch(QLineSeries* series)
-{
-    double mx = DBL_MIN;
-    double mn = DBL_MAX;
-    for (int x = 0; x < series->count(); x++)
-    {
-        mn = fmin(series->at(x).y(), mn);
-        mx = fmax(series->at(x).y(), mx);
-    }
-    for (int x = 0; x < series->count(); x++)
-    {
-        QPointF p = series->at(x);
-        series->replace(x, p.x(), (p.y() - mn) * M_PI * 2.0 / (mx - mn));
-    }
-}
-
 void Line::UnloadPositionChart()
 {
     xyz_locations.clear();
@@ -984,48 +1061,22 @@ void Line::SavePlot()
     if(data.open(QFile::WriteOnly | QFile::Truncate))
     {
         QTextStream output(&data);
-        QMap <double, double> counts, mag, phi;
         switch(getMode()) {
-        case Counter:
+        case Counter: {
             output << "time (s)";
             output << ",counts";
             output << ",autocorrelations (magnitude),autocorrelations (phase)";
             output << "\n";
-            for(int x = 0; x < getCounts()->count(); x++)
-                counts.insert(getCounts()->getSeries()->at(x).x(), getCounts()->getSeries()->at(x).y());
-            for(int x = 0; x < getSpectrum()->count(); x++) {
-                mag.insert(getCounts()->getMagnitude()->at(x).x(), getCounts()->getMagnitude()->at(x).y());
-                phi.insert(getCounts()->getPhase()->at(x).x(), getCounts()->getPhase()->at(x).y());
-            }
-            for(int i = 0, x = 0, y = 0, z = 0; i < fmax(fmax(getCounts()->count(), getSpectrum()->count()), getSpectrum()->getPhase()->count()); i++)
-            {
-                double ctime = DBL_MAX, mtime = DBL_MAX, ptime = DBL_MAX;
-                if(counts.count() > x)
-                    ctime = counts.keys().at(x);
-                if(mag.count() > y)
-                    mtime = mag.keys().at(y);
-                if(phi.count() > y)
-                    ptime = phi.keys().at(z);
-                double time = fmin(fmin(ctime, mtime), ptime);
-                output << QString::number(time);
-                if(counts.keys().at(x) == time) {
-                    output << ","+QString::number(counts[time]);
-                    x++;
-                }
-                if(showAutocorrelations())
-                output << ",";
-                if(mag.keys().at(y) == time) {
-                    output << QString::number(mag[time]);
-                    y++;
-                }
-                output << ",";
-                if(phi.keys().at(z) == time) {
-                    output << QString::number(phi[time]);
-                    z++;
-                }
-                output << "\n";
+            QVector<double> rows[Series::ColumnCount + 1];
+            int from = 0;
+            auto field = [] (double value) { return std::isfinite(value) ? QString::number(value) : QString(); };
+            while(getCounts()->readRows(&from, SPILL_CHUNK_ROWS, rows) > 0) {
+                for(int x = 0; x < rows[0].count(); x++)
+                    output << QString::number(rows[0][x]) + "," + field(rows[1 + Series::CountsColumn][x]) + ","
+                           + field(rows[1 + Series::MagnitudeColumn][x]) + "," + field(rows[1 + Series::PhaseColumn][x]) + "\n";
             }
             break;
+        }
         case Autocorrelator:
             if(idft())
                 output << "'lag (ns)','magnitude','phase'\n";
@@ -1033,8 +1084,8 @@ void Line::SavePlot()
                 output << "'channel','magnitude','phase'\n";
             for(int x = 0, y = 0; x < getSpectrum()->count(); y++, x++)
             {
-                output << "'" + QString::number(getSpectrum()->getMagnitude()->at(y).x()) + "','" + QString::number(getSpectrum()->getMagnitude()->at(y).y()) + "','"
-                       + QString::number(getSpectrum()->getPhase()->at(y).x()) + "','" + QString::number(getSpectrum()->getPhase()->at(y).y()) + "'\n";
+                output << "'" + QString::number(getSpectrum()->getMagnitudePoints()->at(y).x()) + "','" + QString::number(getSpectrum()->getMagnitudePoints()->at(y).y()) + "','"
+                       + QString::number(getSpectrum()->getPhasePoints()->at(y).x()) + "','" + QString::number(getSpectrum()->getPhasePoints()->at(y).y()) + "'\n";
             }
             break;
         default:
@@ -1104,9 +1155,9 @@ void Line::GetDark()
         {
             QStringList lag_value = darkstring[x].split(",");
             if(lag_value.length() == 2)
-                getDark()->insert(lag_value[0].toDouble(), lag_value[1].toDouble());
+                getSpectrum()->addDark(lag_value[0].toDouble(), lag_value[1].toDouble());
         }
-        if(getDark()->count() > 0)
+        if(getSpectrum()->hasDark())
         {
             ui->TakeDark->setText("Clear Dark");
             getSpectrum()->setName(name + " magnitude (residuals)");
@@ -1118,12 +1169,12 @@ void Line::TakeDark(Line *sender)
 {
     if(sender->DarkTaken())
     {
-        getDark()->clear();
+        getSpectrum()->clearDark();
         darkstring = "";
         for(int x = 0; x < getSpectrum()->count(); x++)
         {
-            getDark()->insert(getSpectrum()->getSeries()->at(x).x(), getSpectrum()->getSeries()->at(x).y());
-            darkstring = QString::number(getSpectrum()->getSeries()->at(x).x()) + ";" + QString::number(getSpectrum()->getSeries()->at(x).y()) + '\n';
+            getSpectrum()->addDark(getSpectrum()->getSeriesPoints()->at(x).x(), getSpectrum()->getSeriesPoints()->at(x).y());
+            darkstring = QString::number(getSpectrum()->getSeriesPoints()->at(x).x()) + ";" + QString::number(getSpectrum()->getSeriesPoints()->at(x).y()) + '\n';
         }
         darkstring = QString(QByteArray(darkstring.toStdString().c_str()).toBase64());
         getSpectrum()->setName(name + " magnitude (residuals)");
@@ -1133,48 +1184,11 @@ void Line::TakeDark(Line *sender)
     {
         ui->TakeDark->setText("Apply Dark");
         removeSetting("Dark");
-        getDark()->clear();
+        getSpectrum()->clearDark();
         getSpectrum()->setName(name + " magnitude");
     }
 }
 
-void Line::smoothBuffer(QXYSeries* buf, QList<double> *raw, int offset, int len)
-{
-    if(smooth() == 0)
-        return;
-    if(raw->count() < offset+len)
-        return;
-    if(raw->count() < smooth())
-        return;
-    if(buf->count() < offset+len)
-        return;
-    if(buf->count() < smooth())
-        return;
-    offset = fmax(offset, smooth());
-    int x = 0;
-    for(x = offset/2; x < len-offset/2; x++) {
-        double val = 0.0;
-        for(int y = -offset/2; y < offset/2; y++) {
-            val += raw->at(x-y);
-        }
-        val /= smooth();
-        buf->replace(buf->at(x).x(), buf->at(x).y(), buf->at(x).x(), val-MinValue);
-    }
-    for(x = raw->count()-1; x >= raw->count()-offset/2; x--)
-        buf->replace(buf->at(x).x(), buf->at(x).y(), buf->at(x).x(), buf->at(raw->count()-offset/2-1).y());
-    for(x = offset/2; x >= 0; x--)
-        buf->replace(buf->at(x).x(), buf->at(x).y(), buf->at(x).x(), buf->at(offset/2).y());
-}
-
-void Line::smoothBuffer(double* buf, int len)
-{
-    for(int x = smooth(); x < len; x++) {
-        for(int y = 0; y < smooth(); y++)
-            buf[x] += buf[x-y];
-        buf[x] /= smooth();
-    }
-}
-
 void Line::enableControls(bool enabled)
 {
     ui->Controls->setEnabled(enabled);
@@ -1212,8 +1226,10 @@ void Line::stackCorrelations(ahp_xc_sample *spectrum)
             getSpectrum()->getElemental()->idft();
         if(Align())
             getSpectrum()->getElemental()->run();
-        else
+        else {
+            getSpectrum()->getElemental()->publish();
             getSpectrum()->getElemental()->finish(false, getStartLag(), getLagStep());
+        }
     }
     resetPercentPtr();
     resetStopPtr();
@@ -1222,19 +1238,23 @@ void Line::stackCorrelations(ahp_xc_sample *spectrum)
 
 void Line::plot(bool success, double o, double s)
 {
-    double timespan = s;
-    double offset = o;
+    Elemental::Result aligned = getSpectrum()->getElemental()->alignment();
+    if(aligned == nullptr || aligned->spectrum == nullptr)
+        return;
+    double timespan = aligned->scale;
+    double offset = aligned->offset;
+    Elemental::Snapshot spectrum = aligned->spectrum;
     if(!idft()) {
         if(this->showMagnitude()) {
-            getSpectrum()->stackBuffer(getSpectrum()->getMagnitude(), getSpectrum()->getMagnitudeStack(), getSpectrum()->getElemental()->getMagnitude(), 0, getSpectrum()->getElemental()->getStreamSize(), timespan, offset, 1.0, 0.0);
-            getSpectrum()->buildHistogram(getSpectrum()->getMagnitude(), getSpectrum()->getElemental()->getStream()->magnitude, 100, getSpectrum()->getHistogramStackIndexMagnitude(), getSpectrum()->getHistogramStackMagnitude(), getSpectrum()->getHistogramMagnitude());
+            getSpectrum()->stackBuffer(getSpectrum()->getMagnitude(), getSpectrum()->getMagnitudeStack(), spectrum->stream->magnitude->buf, 0, spectrum->stream->len, timespan, offset, 1.0, 0.0, getSpectrum()->getBand());
+            getSpectrum()->buildHistogram(getSpectrum()->getMagnitude(), 100, getSpectrum()->getHistogramStackIndexMagnitude(), getSpectrum()->getHistogramStackMagnitude(), getSpectrum()->getHistogramMagnitude());
         }
         if(this->showPhase()) {
-            getSpectrum()->stackBuffer(getSpectrum()->getPhase(), getSpectrum()->getPhaseStack(), getSpectrum()->getElemental()->getPhase(), 0, getSpectrum()->getElemental()->getStreamSize(), timespan, offset, 1.0, 0.0);
-            getSpectrum()->buildHistogram(getSpectrum()->getPhase(), getSpectrum()->getElemental()->getStream()->phase, 100, getSpectrum()->getHistogramStackIndexPhase(), getSpectrum()->getHistogramStackPhase(), getSpectrum()->getHistogramPhase());
+            getSpectrum()->stackBuffer(getSpectrum()->getPhase(), getSpectrum()->getPhaseStack(), spectrum->stream->phase->buf, 0, spectrum->stream->len, timespan, offset, 1.0, 0.0);
+            getSpectrum()->buildHistogram(getSpectrum()->getPhase(), 100, getSpectrum()->getHistogramStackIndexPhase(), getSpectrum()->getHistogramStackPhase(), getSpectrum()->getHistogramPhase());
         }
     } else {
-        getSpectrum()->stackBuffer(getSpectrum()->getMagnitude(), getSpectrum()->getStack(), getSpectrum()->getElemental()->getBuffer(), 0, getSpectrum()->getElemental()->getStreamSize(), timespan, offset, 1.0, 0.0);
+        getSpectrum()->stackBuffer(getSpectrum()->getMagnitude(), getSpectrum()->getStack(), spectrum->stream->buf, 0, spectrum->stream->len, timespan, offset, 1.0, 0.0, getSpectrum()->getBand());
     }
     getGraph()->paint();
     gethistogram()->paint();
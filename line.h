@@ -30,6 +30,7 @@
 #include <QThread>
 #include <QWidget>
 #include <QSettings>
+#include <QStandardItem>
 #include <QScatterSeries>
 #include <QSplineSeries>
 #include <QLineSeries>
@@ -198,10 +199,6 @@ class Line : public QWidget
         {
             return spectrum;
         }
-        inline QMap<double, double>* getDark()
-        {
-            return getSpectrum()->getDark();
-        }
         inline int smooth()
         {
             return _smooth;
@@ -236,8 +233,6 @@ class Line : public QWidget
         double *percent;
         double localpercent;
         void setPercent();
-        void smoothBuffer(QXYSeries* buf, QList<double>* raw, int offset, int len);
-        void smoothBuffer(double* buf, int len);
         void addToVLBIContext();
         void removeFromVLBIContext();
 
@@ -375,7 +370,14 @@ class Line : public QWidget
         }
 
         inline double getPacketTime() { return packetTime; }
+        inline void setPacketTime(double time)
+        {
+            packetTime = time;
+            stream->samplerate = 1.0/packetTime;
+            getCounts()->setPacketTime(packetTime);
+        }
         void addCount(double starttime, ahp_xc_packet *packet = nullptr);
+        void addCount(double starttime, ahp_xc_packet **packets, size_t count);
         inline double getTimeRange() { return timeRange; }
         inline void setTimeRange(double range) { timeRange = range; }
         inline ahp_xc_packet* getPacket() { return packet; }
@@ -393,10 +395,8 @@ class Line : public QWidget
         static QMutex motor_mutex;
         QMutex mutex;
         double Frequency { LIGHTSPEED };
-        void stretch(QLineSeries* series);
 
         QString darkstring = { "" };
-        fftw_plan plan { 0 };
         QList<int> Motors;
         Ui::Line *ui { nullptr };
         dsp_stream_p stream { nullptr };
@@ -459,6 +459,9 @@ class Line : public QWidget
         bool altaz { false };
         bool fork { false };
         void getMinMax();
+        void showStatistics();
+        void markMatch(QStandardItem *item, int rank, bool unconfirmed = false);
+        void showRanking();
         void plot(bool success, double o, double s);
         void SavePlot();
 
@@ -0,0 +1,288 @@
+/*
+    MIT License
+
+    xc-gui GUI for libahp_xc and OpenVLBI using the AHP XC correlators
+    Copyright (C) 2020  Ilia Platone
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef LINEINDEX_H
+#define LINEINDEX_H
+
+#include <cmath>
+#include <cfloat>
+#include <map>
+#include <tuple>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <QList>
+#include "types.h"
+
+#define LINEINDEX_NEIGHBORS 5
+#define LINEINDEX_RATIO_STEP 0.02
+#define LINEINDEX_SCALE_STEP 0.02
+#define LINEINDEX_TOLERANCE 0.25
+#define LINEINDEX_MIN_VOTES 2
+#define LINEINDEX_MIN_INLIERS 3
+#define LINEINDEX_CANDIDATES 32
+
+/*
+ * Line position index of a catalog for fast candidate pruning.
+ * Every element keeps its line positions sorted. Every set of three
+ * nearby lines is hashed by the ratio of its two spacings, and every
+ * set of four by the ratios of its outer spacings to the first one,
+ * none of which change with offset or scale. A measured spectrum looks
+ * its own sets up in both hashes, each hit pairs the outer measured
+ * lines with the outer element lines and so votes for an element, a
+ * scale and an offset. Sets of four are more selective, sets of three
+ * let spectra and elements of three lines meet at all.
+ * The best hypothesis of each element is then checked by projecting
+ * its lines onto the measured ones with a binary search, elements with
+ * enough lines landing on measured ones survive, most voted first, with
+ * the offset and scale of their hypothesis (measured = element * scale
+ * + offset). Only the survivors need a full alignment. Elements and
+ * spectra with fewer than three lines have no sets and never match.
+ */
+class LineIndex
+{
+    public:
+        typedef struct
+        {
+            dsp_stream_p element;
+            int votes;
+            int inliers;
+            double offset;
+            double scale;
+        } candidate;
+    private:
+        typedef struct
+        {
+            int element;
+            int first;
+            int second;
+        } entry;
+        typedef struct
+        {
+            int votes;
+            double offset;
+            double scale;
+        } vote;
+        QList<dsp_stream_p> elements;
+        std::vector<std::vector<double>> positions;
+        std::vector<int> sets;
+        std::unordered_map<long long, std::vector<entry>> spacings;
+        std::unordered_map<long long, std::vector<entry>> ratios;
+
+        static inline std::vector<double> peaks(dsp_stream_p stream)
+        {
+            std::vector<double> p;
+            for(int s = 0; s < stream->stars_count; s++)
+                p.push_back(stream->stars[s].center.location[0]);
+            std::sort(p.begin(), p.end());
+            return p;
+        }
+        static inline long long key(long long r1, long long r2)
+        {
+            return (long long)(((unsigned long long)r1 << 32) ^ ((unsigned long long)r2 & 0xffffffffULL));
+        }
+        // the bin of a ratio and the neighbouring bin nearest to it
+        static inline void bins(double r, long long *k, long long *n)
+        {
+            *k = (long long)floor(r);
+            *n = (r - *k < 0.5) ? *k - 1 : *k + 1;
+        }
+        template <typename F>
+        static inline void triples(const std::vector<double> &p, F f)
+        {
+            int n = p.size();
+            for(int i = 0; i < n; i++)
+            {
+                for(int j = i + 1; j < n && j <= i + LINEINDEX_NEIGHBORS; j++)
+                {
+                    for(int k = j + 1; k < n && k <= i + LINEINDEX_NEIGHBORS; k++)
+                    {
+                        double d1 = p[j] - p[i];
+                        double d2 = p[k] - p[j];
+                        if(d1 > 0.0 && d2 > 0.0)
+                            f(i, k, log(d2 / d1) / LINEINDEX_RATIO_STEP);
+                    }
+                }
+            }
+        }
+        template <typename F>
+        static inline void quads(const std::vector<double> &p, F f)
+        {
+            int n = p.size();
+            for(int i = 0; i < n; i++)
+            {
+                for(int j = i + 1; j < n && j <= i + LINEINDEX_NEIGHBORS; j++)
+                {
+                    for(int k = j + 1; k < n && k <= i + LINEINDEX_NEIGHBORS; k++)
+                    {
+                        for(int l = k + 1; l < n && l <= i + LINEINDEX_NEIGHBORS; l++)
+                        {
+                            double d1 = p[j] - p[i];
+                            double d2 = p[k] - p[j];
+                            double d3 = p[l] - p[k];
+                            if(d1 > 0.0 && d2 > 0.0 && d3 > 0.0)
+                                f(i, l, log(d2 / d1) / LINEINDEX_RATIO_STEP, log(d3 / d1) / LINEINDEX_RATIO_STEP);
+                        }
+                    }
+                }
+            }
+        }
+        inline int inliers(int e, double offset, double scale, const std::vector<double> &measured, double tolerance)
+        {
+            int count = 0;
+            std::vector<bool> taken(measured.size(), false);
+            for(double p : positions[e])
+            {
+                double q = p * scale + offset;
+                int m = std::lower_bound(measured.begin(), measured.end(), q) - measured.begin();
+                if(m == (int)measured.size() || (m > 0 && q - measured[m - 1] < measured[m] - q))
+                    m--;
+                // each measured line takes one element line at most
+                if(fabs(measured[m] - q) <= tolerance && !taken[m])
+                {
+                    taken[m] = true;
+                    count++;
+                }
+            }
+            return count;
+        }
+    public:
+        LineIndex() {}
+
+        inline void build(const QList<dsp_stream_p> &catalog)
+        {
+            clear();
+            elements = catalog;
+            for(int e = 0; e < elements.count(); e++)
+            {
+                positions.push_back(peaks(elements[e]));
+                sets.push_back(0);
+                triples(positions[e], [&] (int i, int k, double r)
+                {
+                    entry hit = { e, i, k };
+                    spacings[(long long)floor(r)].push_back(hit);
+                    sets[e]++;
+                });
+                quads(positions[e], [&] (int i, int l, double r1, double r2)
+                {
+                    entry hit = { e, i, l };
+                    ratios[key((long long)floor(r1), (long long)floor(r2))].push_back(hit);
+                    sets[e]++;
+                });
+            }
+        }
+        inline void clear()
+        {
+            elements.clear();
+            positions.clear();
+            sets.clear();
+            spacings.clear();
+            ratios.clear();
+        }
+        inline bool isEmpty()
+        {
+            return elements.isEmpty();
+        }
+        inline std::vector<candidate> candidates(dsp_stream_p spectrum, int max)
+        {
+            std::vector<candidate> found;
+            std::vector<double> measured = peaks(spectrum);
+            if(measured.size() < 3)
+                return found;
+            double tolerance = LINEINDEX_TOLERANCE * (measured.back() - measured.front()) / (measured.size() - 1);
+            if(tolerance <= 0.0)
+                return found;
+            std::map<std::tuple<int, long long, long long>, vote> votes;
+            int measured_sets = 0;
+            auto cast = [&] (const std::vector<entry> &bin, int a, int b)
+            {
+                for(const entry &hit : bin)
+                {
+                    const std::vector<double> &p = positions[hit.element];
+                    double scale = (measured[b] - measured[a]) / (p[hit.second] - p[hit.first]);
+                    double offset = measured[a] - p[hit.first] * scale;
+                    vote &v = votes[std::make_tuple(hit.element, (long long)floor(log(scale) / LINEINDEX_SCALE_STEP),
+                                                    (long long)floor(offset / tolerance))];
+                    v.votes++;
+                    v.offset += offset;
+                    v.scale += scale;
+                }
+            };
+            triples(measured, [&] (int a, int b, double r)
+            {
+                long long k, n;
+                bins(r, &k, &n);
+                for(long long s : { k, n })
+                {
+                    auto bin = spacings.find(s);
+                    if(bin != spacings.end())
+                        cast(bin->second, a, b);
+                }
+                measured_sets++;
+            });
+            quads(measured, [&] (int a, int b, double r1, double r2)
+            {
+                long long k1, n1, k2, n2;
+                bins(r1, &k1, &n1);
+                bins(r2, &k2, &n2);
+                for(long long s : { key(k1, k2), key(n1, k2), key(k1, n2), key(n1, n2) })
+                {
+                    auto bin = ratios.find(s);
+                    if(bin != ratios.end())
+                        cast(bin->second, a, b);
+                }
+                measured_sets++;
+            });
+            std::vector<vote> best(elements.count(), vote { 0, 0.0, 0.0 });
+            for(auto &it : votes)
+            {
+                int e = std::get<0>(it.first);
+                if(it.second.votes > best[e].votes)
+                    best[e] = it.second;
+            }
+            for(int e = 0; e < elements.count(); e++)
+            {
+                // three lines make a single set, which can only vote once
+                if(best[e].votes == 0 || best[e].votes < std::min(LINEINDEX_MIN_VOTES, std::min(sets[e], measured_sets)))
+                    continue;
+                double offset = best[e].offset / best[e].votes;
+                double scale = best[e].scale / best[e].votes;
+                int count = inliers(e, offset, scale, measured, tolerance);
+                if(count < LINEINDEX_MIN_INLIERS)
+                    continue;
+                candidate c = { elements[e], best[e].votes, count, offset, scale };
+                found.push_back(c);
+            }
+            std::sort(found.begin(), found.end(), [] (const candidate & a, const candidate & b)
+            {
+                return a.votes != b.votes ? a.votes > b.votes : a.inliers > b.inliers;
+            });
+            if(max > 0 && (int)found.size() > max)
+                found.resize(max);
+            return found;
+        }
+};
+
+#endif // LINEINDEX_H
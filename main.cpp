@@ -54,6 +54,7 @@ int main(int argc, char *argv[])
     signal(SIGSEGV, signal_handler);
     signal(SIGABRT, signal_handler);
     QApplication a(argc, argv);
+    Plans::init();
     dsp_set_app_name((char*)"xc-gui");
     dsp_set_debug_level(10);
     MainWindow w;
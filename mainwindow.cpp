@@ -272,7 +272,9 @@ void MainWindow::SaveValues()
     settings->setValue("MotorPort", ui->MotorPort->currentText());
     settings->setValue("firmware", ui->firmware->currentText());
     settings->setValue("extclock", ui->extclock->isChecked());
+    settings->setValue("Record", ui->Record->isChecked());
     settings->setValue("Baudrate", ui->Baudrate->currentIndex());
+    settings->setValue("ReplaySpeed", ui->ReplaySpeed->currentIndex());
     settings->setValue("Mode", ui->Mode->currentIndex());
     settings->setValue("Range", ui->Range->value());
     settings->setValue("Order", ui->Order->value());
@@ -285,7 +287,9 @@ void MainWindow::ReadValues()
     ui->MotorPort->setCurrentText(settings->value("MotorPort", "no connection").toString());
     ui->firmware->setCurrentText(settings->value("firmware", "").toString());
     ui->extclock->setChecked(settings->value("extclock", false).toBool());
+    ui->Record->setChecked(settings->value("Record", false).toBool());
     ui->Baudrate->setCurrentIndex(settings->value("Baudrate", 0).toInt());
+    ui->ReplaySpeed->setCurrentIndex(settings->value("ReplaySpeed", 0).toInt());
     ui->Mode->setCurrentIndex(settings->value("Mode", 0).toInt());
     ui->Order->setValue(settings->value("Order", 2).toInt());
     emit readValues();
@@ -315,6 +319,7 @@ MainWindow::MainWindow(QWidget *parent)
         f->~QFile();
     }
     settings = new QSettings(ini, QSettings::Format::IniFormat);
+    Plans::loadWisdom(homedir + dir_separator + "fftw.wisdom");
     QString url = "https://www.iliaplatone.com/firmware.php?product=";
     bsdl_filename = homedir + dir_separator + strrand(32) + ".bsm";
     svf_filename = homedir + dir_separator + strrand(32) + ".svf";;
@@ -336,9 +341,27 @@ MainWindow::MainWindow(QWidget *parent)
         ahp_set_stderr(f_stdout);
     }
     ui->setupUi(this);
-    uiThread = new Thread(this, 50, 50, "uiThread");
+    latencyStatus = new QLabel(this);
+    statusBar()->addPermanentWidget(latencyStatus);
+    dropsStatus = new QLabel(this);
+    statusBar()->addPermanentWidget(dropsStatus);
+    statusClock.start();
+    uiThread = new Thread(this, 50, 500, "uiThread");
     sendThread = new Thread(this, 1, 1000, "sendThread");
-    readThread = new Thread(this, 1, 1, "readThread");
+    readThread = new Thread(this, 0, 0, "readThread");
+    packetThread = new Thread(this, 0, 0, "packetThread");
+    packetRing = new Ring<ahp_xc_packet*>(PACKET_RING_SIZE);
+    packetPool = new PacketPool();
+    packetPool->setReleased([ = ] ()
+    {
+        if(readStarved.exchange(false))
+            readThread->wake();
+    });
+    dispatcher = new Dispatcher(QThread::idealThreadCount());
+    recorder = new Recorder();
+    replay = new Replay();
+    emulator = new Emulator();
+    drops = new Drops();
     vlbiThread = new Thread(this, 500, 500, "vlbiThread");
     motorThread = new Thread(this, 500, 500, "motorThread");
     graph = new Graph(settings, this);
@@ -356,6 +379,9 @@ MainWindow::MainWindow(QWidget *parent)
     ui->XCPort->clear();
     ui->XCPort->addItem(settings->value("xc_connection", "no connection").toString());
     ui->XCPort->addItem("localhost:5760");
+    ui->XCPort->addItem("emulator");
+    for(QString capture : QDir(homedir).entryList(QStringList("*.xcr"), QDir::Files, QDir::Time))
+        ui->XCPort->addItem(homedir + dir_separator + capture);
     ui->XCPort->setCurrentIndex(0);
     ui->MotorPort->clear();
     ui->MotorPort->addItem(settings->value("motor_connection", "no connection").toString());
@@ -410,6 +436,11 @@ MainWindow::MainWindow(QWidget *parent)
                 if(ui->extclock->isChecked())
                     ahp_xc_set_capture_flags((xc_capture_flags)(ahp_xc_get_capture_flags()|CAP_EXT_CLK));
             });
+    connect(ui->Record, static_cast<void (QCheckBox::*)(bool)>(&QCheckBox::clicked),
+            [ = ](bool checked)
+            {
+                SaveValues();
+            });
     connect(ui->Order, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged),
             [ = ](int value)
             {
@@ -430,6 +461,7 @@ MainWindow::MainWindow(QWidget *parent)
         for(Polytope * line : Polytopes)
         {
             getGraph()->removeSeries(line->getSpectrum()->getMagnitude());
+            getGraph()->removeSeries(line->getSpectrum()->getBand());
             getHistogram()->removeSeries(line->getCounts()->getHistogram());
             line->~Polytope();
         }
@@ -438,13 +470,19 @@ MainWindow::MainWindow(QWidget *parent)
             getGraph()->removeSeries(line->getCounts()->getSeries());
             getGraph()->removeSeries(line->getCounts()->getMagnitude());
             getGraph()->removeSeries((QLineSeries*)line->getSpectrum()->getMagnitude());
+            getGraph()->removeSeries(line->getSpectrum()->getBand());
             getHistogram()->removeSeries(line->getCounts()->getHistogram());
             line->~Line();
         }
+        recorder->close();
+        dispatcher->clear();
         Polytopes.clear();
         Lines.clear();
         ui->Lines->clear();
         freePacket();
+        replay->close();
+        emulator->close();
+        source = nullptr;
         ahp_xc_set_capture_flags(CAP_NONE);
         ahp_xc_disconnect();
         if(xc_socket.isOpen())
@@ -488,6 +526,14 @@ MainWindow::MainWindow(QWidget *parent)
         ahp_xc_set_baudrate((baud_rate)index);
         SaveValues();
     });
+    connect(ui->ReplaySpeed, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
+    [ = ](int index)
+    {
+        QString speed = ui->ReplaySpeed->itemText(index);
+        replay->setSpeed(speed == "Max" ? 0.0 : speed.replace("x", "").toDouble());
+        emulator->setSpeed(replay->getSpeed());
+        SaveValues();
+    });
     connect(ui->firmware, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
     [ = ](int index)
     {
@@ -529,7 +575,46 @@ MainWindow::MainWindow(QWidget *parent)
         }
         else
         {
-            if(xcport.contains(':'))
+            if(xcport.endsWith(".xcr"))
+            {
+                if(!replay->open(xcport))
+                {
+                    fprintf(f_stdout, "Invalid capture file %s\n", xcport.toStdString().c_str());
+                    goto err_exit;
+                }
+                source = replay;
+            }
+            else if(xcport == "emulator")
+            {
+                settings->beginGroup("Emulator");
+                int nlines = settings->value("lines", 8).toInt();
+                int autolag = settings->value("autolag", 1).toInt();
+                int crosslag = settings->value("crosslag", 1).toInt();
+                double packettime = settings->value("packettime", 0.01).toDouble();
+                double rate = settings->value("rate", 10000.0).toDouble();
+                double correlation = settings->value("correlation", 0.5).toDouble();
+                double delay = settings->value("delay", 1.0).toDouble();
+                double amplitude = settings->value("amplitude", 0.1).toDouble();
+                double frequency = settings->value("frequency", 1.0).toDouble();
+                settings->setValue("lines", nlines);
+                settings->setValue("autolag", autolag);
+                settings->setValue("crosslag", crosslag);
+                settings->setValue("packettime", packettime);
+                settings->setValue("rate", rate);
+                settings->setValue("correlation", correlation);
+                settings->setValue("delay", delay);
+                settings->setValue("amplitude", amplitude);
+                settings->setValue("frequency", frequency);
+                settings->endGroup();
+                emulator->setSignal(rate, correlation, delay, amplitude, frequency);
+                if(!emulator->open(nlines, autolag, crosslag, packettime))
+                {
+                    fprintf(f_stdout, "Invalid emulator settings\n");
+                    goto err_exit;
+                }
+                source = emulator;
+            }
+            else if(xcport.contains(':'))
             {
                 address = xcport.split(":")[0];
                 port = xcport.split(":")[1].toInt();
@@ -544,7 +629,7 @@ MainWindow::MainWindow(QWidget *parent)
                 xcFD = ahp_xc_get_fd();
 
             }
-            if(ahp_xc_is_detected())
+            if(source != nullptr || ahp_xc_is_detected())
             {
                 motorFD = -1;
                 if(motorport == "no connection")
@@ -601,7 +686,7 @@ MainWindow::MainWindow(QWidget *parent)
                 }
                 connected = true;
                 settings->setValue("xc_connection", xcport);
-                QString header = ahp_xc_get_header();
+                QString header = (source != nullptr) ? QString(source->getHeader()->device) : QString(ahp_xc_get_header());
                 QString devices = settings->value("devices", "").toString();
                 if(!devices.contains(header))
                 {
@@ -613,12 +698,21 @@ MainWindow::MainWindow(QWidget *parent)
                 settings->endGroup();
                 settings->beginGroup(header);
 
-                for(unsigned int l = 0; l < ahp_xc_get_nlines(); l++)
+                dispatcher->addConsumer([ = ] ()
+                {
+                    return recorder->isRecording();
+                }, [ = ](ahp_xc_packet **packets, size_t count)
+                {
+                    recorder->write(packets, count);
+                });
+
+                for(unsigned int l = 0; l < getNLines(); l++)
                 {
                     QString name = "Line " + QString::number(l + 1);
                     fprintf(f_stdout, "Adding %s\n", name.toStdString().c_str());
                     Lines.append(new Line(name, l, settings, ui->Lines, &Lines));
                     Lines[l]->setTimeRange(TimeRange);
+                    Lines[l]->setPacketTime(getPacketTime());
                     connect(this, static_cast<void (MainWindow::*)()>(&MainWindow::scanStarted), [ = ] () {
                         Lines[l]->enableControls(false);
                     });
@@ -640,6 +734,14 @@ MainWindow::MainWindow(QWidget *parent)
                     });
                     connect(Lines[l], static_cast<void (Line::*)(Line*)>(&Line::scanActiveStateChanged),
                             [ = ](Line* line) {
+                        dispatcher->invalidate();
+                        readThread->wake();
+                    });
+                    connect(Lines[l], static_cast<void (Line::*)(Line*)>(&Line::activeStateChanged),
+                            [ = ](Line* line) {
+                        if(!line->isActive())
+                            line->clearCounts();
+                        dispatcher->invalidate();
                     });
                     connect(Lines[l], static_cast<void (Line::*)(bool)>(&Line::crossCorrelationEnabled), [=](bool enabled) {
                         int max_order = 0;
@@ -656,14 +758,28 @@ MainWindow::MainWindow(QWidget *parent)
                         }
                         setOrder();
                     });
-                    connect(this, static_cast<void (MainWindow::*)(ahp_xc_packet*)>(&MainWindow::newPacket), this, [ = ](ahp_xc_packet *packet)
+                    dispatcher->addConsumer([ = ] ()
+                    {
+                        return true;
+                    }, [ = ](ahp_xc_packet **packets, size_t count)
                     {
-                        Lines[l]->addCount(J2000_starttime, packet);
+                        (void)packets;
+                        // the rails step to the next location once per packet
+                        for(size_t n = 0; n < count; n++)
+                            Lines[l]->setLocation();
+                    }, true);
+                    dispatcher->addConsumer([ = ] ()
+                    {
+                        return Lines[l]->isActive() || Lines[l]->scanActive();
+                    }, [ = ](ahp_xc_packet **packets, size_t count)
+                    {
+                        Lines[l]->addCount(J2000_starttime, packets, count);
                     });
                     connect(getGraph(), static_cast<void (Graph::*)(Mode)>(&Graph::modeChanging), this, [=] (Mode m) {
                         switch(m) {
                         case Autocorrelator:
                             getGraph()->addSeries(Lines[l]->getSpectrum()->getMagnitude(), QString::number(Autocorrelator) + "0#" + QString::number(l+1));
+                            getGraph()->addSeries(Lines[l]->getSpectrum()->getBand(), QString::number(Autocorrelator) + "0#" + QString::number(l+1) + " error");
                             getGraph()->addSeries(Lines[l]->getSpectrum()->getPhase(), QString::number(Autocorrelator) + "0#" + QString::number(l+1));
                             getHistogram()->addSeries(Lines[l]->getSpectrum()->getHistogramMagnitude(), QString::number(Autocorrelator) + "0#" + QString::number(l+1));
                             getHistogram()->addSeries(Lines[l]->getSpectrum()->getHistogramPhase(), QString::number(Autocorrelator) + "0#" + QString::number(l+1));
@@ -695,15 +811,31 @@ MainWindow::MainWindow(QWidget *parent)
                     Lines[l]->Initialize();
                     ui->Lines->addTab(Lines[l], name);
                 }
-                for(unsigned int idx = 0; idx < ahp_xc_get_nbaselines(); idx++)
+                for(unsigned int idx = 0; idx < getNBaselines(); idx++)
                 {
                     QString name = "Polytope " + QString::number(idx);
                     fprintf(f_stdout, "Adding %s\n", name.toStdString().c_str());
                     Polytopes.append(new Polytope(name, idx, Lines, settings));
+                    Polytopes[idx]->setSource(source);
                     Polytopes[idx]->setTimeRange(TimeRange);
-                    connect(this, static_cast<void (MainWindow::*)(ahp_xc_packet*)>(&MainWindow::newPacket), [ = ](ahp_xc_packet *packet)
+                    Polytopes[idx]->setPacketTime(getPacketTime());
+                    dispatcher->addConsumer([ = ] ()
+                    {
+                        return Polytopes[idx]->scanActive();
+                    }, [ = ](ahp_xc_packet **packets, size_t count)
+                    {
+                        Polytopes[idx]->steer(J2000_starttime, packets, count);
+                    }, true);
+                    dispatcher->addConsumer([ = ] ()
                     {
-                        Polytopes[idx]->addCount(J2000_starttime, packet);
+                        return Polytopes[idx]->isActive() || Polytopes[idx]->scanActive();
+                    }, [ = ](ahp_xc_packet **packets, size_t count)
+                    {
+                        Polytopes[idx]->addCount(J2000_starttime, packets, count);
+                    });
+                    connect(Polytopes[idx], static_cast<void (Polytope::*)(Polytope*)>(&Polytope::activeStateChanging), [ = ](Polytope*)
+                    {
+                        dispatcher->invalidate();
                     });
                     connect(getGraph(), static_cast<void (Graph::*)(Mode)>(&Graph::modeChanging), this, [=] (Mode m) {
                         switch(m) {
@@ -712,6 +844,7 @@ MainWindow::MainWindow(QWidget *parent)
                         case CrosscorrelatorII:
                         case CrosscorrelatorIQ:
                             getGraph()->addSeries(Polytopes[idx]->getSpectrum()->getMagnitude(), QString::number(CrosscorrelatorII) + "0#" + QString::number(idx+1));
+                            getGraph()->addSeries(Polytopes[idx]->getSpectrum()->getBand(), QString::number(CrosscorrelatorII) + "0#" + QString::number(idx+1) + " error");
                             getGraph()->addSeries(Polytopes[idx]->getSpectrum()->getPhase(), QString::number(CrosscorrelatorII) + "0#" + QString::number(idx+1));
                             getHistogram()->addSeries(Polytopes[idx]->getSpectrum()->getHistogramMagnitude(), QString::number(CrosscorrelatorII) + "0#" + QString::number(idx+1));
                             getHistogram()->addSeries(Polytopes[idx]->getSpectrum()->getHistogramPhase(), QString::number(CrosscorrelatorII) + "0#" + QString::number(idx+1));
@@ -805,9 +938,6 @@ err_exit:
     connect(this, static_cast<void (MainWindow::*)()>(&MainWindow::repaint), this, [ = ]()
     {
     });
-    connect(this, static_cast<void (MainWindow::*)(ahp_xc_packet*)>(&MainWindow::newPacket), this, [ = ](ahp_xc_packet *packet)
-    {
-    });
     connect(sendThread, static_cast<void (Thread::*)(Thread*)>(&Thread::threadLoop), [ = ] (Thread * thread)
     {
         if(threadsStopped)
@@ -838,9 +968,13 @@ err_exit:
         int y = 0;
         int off = 0;
         ahp_xc_packet *packet;
+        ahp_xc_packet **slot = nullptr;
+        qint64 stamp;
         QList<ahp_xc_scan_request> requests;
         ahp_xc_sample *spectrum = nullptr;
         int npackets;
+        // correlator scans only loop while something scans, a scan starting wakes the thread again
+        bool again = false;
         getGraph()->setupAxes(1,1,"","","%.03f","%.03f",10, 10);
         if(threadsStopped)
             goto end_unlock;
@@ -852,6 +986,7 @@ err_exit:
                 {
                     if(line->scanActive())
                     {
+                        again = true;
                         line->setPercentPtr(&percent);
                         line->stackCorrelations();
                     } else {
@@ -878,6 +1013,9 @@ err_exit:
                         line->resetPercentPtr();
                     }
                 }
+                again = !requests.isEmpty();
+                if(!again)
+                    break;
                 ahp_xc_set_correlation_order(1);
                 npackets = ahp_xc_scan_correlations(requests.toVector().data(), requests.count(), &spectrum, &threadsStopped, &percent);
                 if(npackets == 0)
@@ -902,24 +1040,96 @@ err_exit:
                 }
                 break;
             default:
-                if(!ahp_xc_get_packet(getPacket())) {
-                    packet = ahp_xc_copy_packet(getPacket());
+                again = true;
+                slot = packetRing->back();
+                packet = (slot != nullptr) ? packetPool->acquire() : nullptr;
+                if(packet == nullptr) {
+                    if(source != nullptr) {
+                        // sources wait for the packet thread to free a slot or a packet
+                        readStarved = true;
+                        if(packetRing->back() == nullptr || packetPool->available() == 0)
+                            again = false;
+                        else
+                            readStarved = false;
+                    } else if(!ahp_xc_get_packet(getPacket())) {
+                        drops->receive(getPacket()->timestamp, getPacketTime());
+                        drops->account(slot == nullptr ? Drops::RingFull : Drops::PoolEmpty);
+                    }
+                    break;
+                }
+                stamp = Latency::now();
+                if(!readPacket(packet)) {
+                    Latency::record(Latency::Read, stamp);
+                    packetPool->setStamp(packet, Latency::now());
+                    readErrors = 0;
+                    drops->receive(packet->timestamp, getPacketTime());
                     double diff = packet->timestamp - lastpackettime;
                     lastpackettime = packet->timestamp;
-                    lock();
-                    if(diff < TimeRange)
-                        newPacket(packet);
-                    unlock();
-                    ahp_xc_free_packet(packet);
+                    if(diff < TimeRange) {
+                        *slot = packet;
+                        packetRing->push();
+                        packetThread->wake();
+                        break;
+                    }
+                    drops->account(Drops::Late);
+                } else if(!(source != nullptr && source->atEnd())) {
+                    drops->account(Drops::ReadError);
+                    // back off exponentially instead of retrying a failing device at once
+                    again = false;
+                    readErrors = qMin(readErrors + 1, 16);
+                    thread->wake(qMin(1 << (readErrors - 1), READ_BACKOFF_MAX));
                 }
+                packetPool->release(packet);
                 break;
         }
     end_unlock:
 
         thread->unlock();
+        if(again && !threadsStopped && !(source != nullptr && source->atEnd()))
+            thread->wake();
+    });
+    connect(packetThread, static_cast<void (Thread::*)(Thread*)>(&Thread::threadLoop), [ = ] (Thread * thread)
+    {
+        ahp_xc_packet *batch[PACKET_BATCH_SIZE];
+        size_t count = 0;
+        ahp_xc_packet **slot = packetRing->front();
+        while(slot != nullptr || count > 0)
+        {
+            if(slot != nullptr && count < PACKET_BATCH_SIZE)
+            {
+                batch[count++] = *slot;
+                packetRing->pop();
+                slot = packetRing->front();
+                continue;
+            }
+            for(size_t x = 0; x < count; x++)
+                Latency::record(Latency::Dispatch, packetPool->getStamp(batch[x]));
+            Latency::setOrigin(packetPool->getStamp(batch[0]));
+            lock();
+            dispatcher->dispatch(batch, count);
+            unlock();
+            Latency::publish(Latency::origin());
+            for(size_t x = 0; x < count; x++)
+                packetPool->release(batch[x]);
+            count = 0;
+            uiThread->wake();
+        }
+        if(readStarved.exchange(false))
+            readThread->wake();
+        thread->unlock();
     });
     connect(uiThread, static_cast<void (Thread::*)(Thread*)>(&Thread::threadLoop), this, [ = ] (Thread * thread)
     {
+        qint64 origin = Latency::take();
+        int width = getGraph()->plotWidth();
+        for(Line *line : Lines) {
+            line->getCounts()->setWidth(width);
+            line->getSpectrum()->setWidth(width);
+        }
+        for(Polytope *polytope : Polytopes) {
+            polytope->getCounts()->setWidth(width);
+            polytope->getSpectrum()->setWidth(width);
+        }
         for(int x = 0; x < Lines.count(); x++)
             Lines.at(x)->paint();
         fseek(f_stdout, 0, SEEK_END);
@@ -948,7 +1158,25 @@ err_exit:
         }
         for(Line *line : Lines)
             line->paint();
+        for(Polytope *polytope : Polytopes) {
+            polytope->getCounts()->publish();
+            polytope->getSpectrum()->publish();
+        }
         getGraph()->paint();
+        if(!threadsStopped && statusClock.elapsed() >= STATUS_INTERVAL) {
+            statusClock.restart();
+            if(Latency::count(Latency::Read) > 0)
+                latencyStatus->setText(Latency::summary());
+            if(drops->getReceived() > 0)
+                dropsStatus->setText(drops->summary());
+        }
+        if(origin > 0) {
+            Latency::record(Latency::Paint, origin);
+            QTimer::singleShot(0, this, [ = ] ()
+            {
+                Latency::record(Latency::Present, origin);
+            });
+        }
         thread->unlock();
     });
     connect(vlbiThread, static_cast<void (Thread::*)(Thread*)>(&Thread::threadLoop), this, [ = ] (Thread * thread)
@@ -959,13 +1187,13 @@ err_exit:
             if(enable_vlbi) {
                 vlbi_get_uv_plot(getVLBIContext(), "coverage",
                                  getGraph()->getPlotSize(), getGraph()->getPlotSize(), radec,
-                                 getGraph()->getFrequency(), 1.0 / ahp_xc_get_packettime(), 1, 0, coverage_delegate, &threadsStopped);
+                                 getGraph()->getFrequency(), 1.0 / getPacketTime(), 1, 0, coverage_delegate, &threadsStopped);
                 vlbi_get_uv_plot(getVLBIContext(), "magnitude",
                                  getGraph()->getPlotSize(), getGraph()->getPlotSize(), radec,
-                                 getGraph()->getFrequency(), 1.0 / ahp_xc_get_packettime(), 1, 0, vlbi_magnitude_delegate, &threadsStopped);
+                                 getGraph()->getFrequency(), 1.0 / getPacketTime(), 1, 0, vlbi_magnitude_delegate, &threadsStopped);
                 vlbi_get_uv_plot(getVLBIContext(), "phase",
                                  getGraph()->getPlotSize(), getGraph()->getPlotSize(), radec,
-                                 getGraph()->getFrequency(), 1.0 / ahp_xc_get_packettime(), 1, 0, vlbi_phase_delegate, &threadsStopped);
+                                 getGraph()->getFrequency(), 1.0 / getPacketTime(), 1, 0, vlbi_phase_delegate, &threadsStopped);
                 if(getGraph()->isTracking()) {
                     if(vlbi_has_model(getVLBIContext(), "coverage_stack"))
                         vlbi_stack_models(getVLBIContext(), "coverage_stack", "coverage_stack", "coverage");
@@ -1008,7 +1236,7 @@ err_exit:
         }
         thread->unlock();
     });
-    resize(1280, 720);
+    resize(1620, 720);
     ReadValues();
 }
 
@@ -1026,6 +1254,7 @@ void MainWindow::resizeEvent(QResizeEvent* event)
 void MainWindow::startThreads()
 {
     uiThread->start();
+    packetThread->start();
     readThread->start();
     sendThread->start();
     motorThread->start();
@@ -1040,7 +1269,10 @@ void MainWindow::stopThreads()
     uiThread->stop();
     sendThread->stop();
     readThread->stop();
+    packetThread->stop();
     motorThread->stop();
+    readThread->wait();
+    packetThread->wait();
 }
 
 void MainWindow::runClicked(bool checked)
@@ -1051,9 +1283,24 @@ void MainWindow::runClicked(bool checked)
     {
         ui->Run->setText("Stop");
         resetTimestamp();
+        Latency::reset();
+        latencyStatus->clear();
+        drops->reset();
+        dropsStatus->clear();
         ahp_xc_set_capture_flags((xc_capture_flags)(ahp_xc_get_capture_flags() & ~(CAP_ENABLE)));
         if(getMode() != Autocorrelator && getMode() != CrosscorrelatorII && getMode() != CrosscorrelatorIQ)
+        {
+            if(source != nullptr)
+                source->rewind();
+            else if(ui->Record->isChecked())
+            {
+                QString filename = homedir + QDir::separator() + QDateTime::currentDateTimeUtc().toString(Qt::DateFormat::ISODate).replace(":", "") + ".xcr";
+                if(recorder->open(filename, J2000_starttime))
+                    fprintf(f_stdout, "Recording to %s\n", filename.toStdString().c_str());
+                dispatcher->invalidate();
+            }
             ahp_xc_set_capture_flags((xc_capture_flags)(ahp_xc_get_capture_flags() | CAP_ENABLE));
+        }
         if(getMode() == HolographIQ || getMode() == HolographII) {
             vlbiThread->start();
         }
@@ -1075,13 +1322,32 @@ void MainWindow::runClicked(bool checked)
         if(getMode() == Autocorrelator)
             emit scanStarted();
         threadsStopped = false;
+        // the error count belongs to the read thread, a new run starts without backoff
+        readThread->post([ = ] () { readErrors = 0; });
+        readThread->wake();
     }
     else
     {
         ui->Run->setText("Run");
         threadsStopped = true;
+        if(Latency::count(Latency::Read) > 0)
+        {
+            QString filename = homedir + QDir::separator() + "latency-" + QDateTime::currentDateTimeUtc().toString(Qt::DateFormat::ISODate).replace(":", "") + ".csv";
+            Latency::dump(filename);
+            latencyStatus->setText(Latency::summary());
+            fprintf(f_stdout, "%s\n", Latency::summary().toStdString().c_str());
+        }
+        if(drops->getReceived() > 0) {
+            dropsStatus->setText(drops->summary());
+            fprintf(f_stdout, "%s\n", drops->summary().toStdString().c_str());
+        }
         if(getMode() != Autocorrelator && getMode() != CrosscorrelatorII && getMode() != CrosscorrelatorIQ)
             ahp_xc_set_capture_flags((xc_capture_flags)(ahp_xc_get_capture_flags() & ~CAP_ENABLE));
+        if(recorder->isRecording())
+        {
+            recorder->close();
+            dispatcher->invalidate();
+        }
         if(getMode() == HolographIQ || getMode() == HolographII) {
             vlbiThread->stop();
         }
@@ -1139,16 +1405,26 @@ MainWindow::~MainWindow()
     vlbiThread->stop();
     sendThread->stop();
     readThread->stop();
+    packetThread->stop();
     motorThread->stop();
     uiThread->wait();
     vlbiThread->wait();
     sendThread->wait();
     readThread->wait();
+    packetThread->wait();
     motorThread->wait();
     if(connected)
     {
         ui->Disconnect->clicked(false);
     }
+    Plans::saveWisdom(homedir + QDir::separator() + "fftw.wisdom");
+    delete packetRing;
+    delete packetPool;
+    delete recorder;
+    delete replay;
+    delete emulator;
+    delete drops;
+    delete dispatcher;
     getHistogram()->~Graph();
     getGraph()->~Graph();
     settings->~QSettings();
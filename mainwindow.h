@@ -27,6 +27,7 @@
 #define MAINWINDOW_H
 
 #include <limits>
+#include <atomic>
 #include <cmath>
 #include <ctime>
 #include <cstring>
@@ -36,6 +37,8 @@
 #include <fcntl.h>
 #include <QThread>
 #include <QStatusBar>
+#include <QLabel>
+#include <QElapsedTimer>
 #include <QTimer>
 #include <QTemporaryFile>
 #include <QCoreApplication>
@@ -62,7 +65,23 @@
 #include "line.h"
 #include "polytope.h"
 #include "types.h"
+#include "ring.h"
+#include "pool.h"
+#include "dispatcher.h"
+#include "recorder.h"
+#include "replay.h"
+#include "emulator.h"
+#include "drops.h"
+#include "plans.h"
 #define NUM_CONTEXTS 4
+#define PACKET_RING_SIZE 256
+#define PACKET_POOL_MIN 16
+#define PACKET_POOL_BYTES (64 << 20)
+#define PACKET_BATCH_SIZE 64
+// refresh period of the running statistics in the status bar, in milliseconds
+#define STATUS_INTERVAL 1000
+// longest pause of the read thread after consecutive read errors, in milliseconds
+#define READ_BACKOFF_MAX 1000
 
 #define fdclose(fd, mode) (fclose(fdopen(fd, mode)))
 
@@ -115,9 +134,48 @@ class MainWindow : public QMainWindow
         {
             return TimeRange;
         }
+        inline unsigned int getNLines()
+        {
+            return (source != nullptr) ? source->getHeader()->nlines : ahp_xc_get_nlines();
+        }
+        inline unsigned int getNBaselines()
+        {
+            return (source != nullptr) ? source->getHeader()->nbaselines : ahp_xc_get_nbaselines();
+        }
+        inline unsigned int getAutocorrelatorLagSize()
+        {
+            return (source != nullptr) ? source->getHeader()->autolag : ahp_xc_get_autocorrelator_lagsize();
+        }
+        inline unsigned int getCrosscorrelatorLagSize()
+        {
+            return (source != nullptr) ? source->getHeader()->crosslag : ahp_xc_get_crosscorrelator_lagsize();
+        }
+        inline double getPacketTime()
+        {
+            return (source != nullptr) ? source->getHeader()->packettime : ahp_xc_get_packettime();
+        }
+        inline ahp_xc_packet *allocPacket()
+        {
+            return (source != nullptr) ? source->allocPacket() : ahp_xc_alloc_packet();
+        }
+        inline void deletePacket(ahp_xc_packet *p)
+        {
+            if(source != nullptr)
+                source->freePacket(p);
+            else
+                ahp_xc_free_packet(p);
+        }
+        inline int readPacket(ahp_xc_packet *p)
+        {
+            return (source != nullptr) ? source->read(p) : ahp_xc_get_packet(p);
+        }
         inline ahp_xc_packet * createPacket()
         {
-            packet = ahp_xc_alloc_packet();
+            size_t packetsize = PacketPool::packetSize(getNLines(), getNBaselines(), getAutocorrelatorLagSize(), getCrosscorrelatorLagSize());
+            packet = allocPacket();
+            packetRing->clear();
+            packetPool->alloc(fmin(packetRing->capacity(), fmax(PACKET_POOL_MIN, PACKET_POOL_BYTES / packetsize)),
+                              [ = ] () { return allocPacket(); }, [ = ] (ahp_xc_packet *p) { deletePacket(p); });
             for(Line* line : Lines)
                 line->setPacket (packet);
             for(Polytope* line : Polytopes)
@@ -127,7 +185,9 @@ class MainWindow : public QMainWindow
         inline void freePacket()
         {
             ahp_xc_enable_intensity_crosscorrelator(false);
-            ahp_xc_free_packet(packet);
+            packetRing->clear();
+            packetPool->free();
+            deletePacket(packet);
         }
         inline Graph *getGraph()
         {
@@ -187,6 +247,7 @@ class MainWindow : public QMainWindow
                 for(int x = 0; x < Lines.count(); x++) {
                     Lines[x]->setActive(false);
                 }
+                dispatcher->invalidate();
                 resizeEvent(nullptr);
                 startThreads();
             }
@@ -198,9 +259,19 @@ class MainWindow : public QMainWindow
         void resetTimestamp();
         void VlbiThread(Thread * thread);
         QDateTime start;
-        QQueue <ahp_xc_packet*> packetFifo;
+        Ring <ahp_xc_packet*> *packetRing;
+        PacketPool *packetPool;
+        Dispatcher *dispatcher;
+        Recorder *recorder;
+        Replay *replay;
+        Emulator *emulator;
+        Source *source { nullptr };
+        Drops *drops;
         Thread *sendThread;
         Thread *readThread;
+        std::atomic<bool> readStarved { false };
+        int readErrors { 0 };
+        Thread *packetThread;
         Thread *uiThread;
         Thread *vlbiThread;
         Thread *motorThread;
@@ -267,7 +338,6 @@ class MainWindow : public QMainWindow
         void ReadValues();
 
 signals:
-        void newPacket(ahp_xc_packet*);
         void repaint();
         void scanStarted();
         void scanFinished(bool complete);
@@ -276,6 +346,9 @@ signals:
 
     private:
         int lastlog_pos { 0 };
+        QLabel *latencyStatus;
+        QLabel *dropsStatus;
+        QElapsedTimer statusClock;
         bool enable_vlbi {false};
         bool has_svf_firmware {false};
         bool has_bsdl {false};
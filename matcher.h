@@ -0,0 +1,98 @@
+/*
+    MIT License
+
+    xc-gui GUI for libahp_xc and OpenVLBI using the AHP XC correlators
+    Copyright (C) 2020  Ilia Platone
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef MATCHER_H
+#define MATCHER_H
+
+#include <mutex>
+#include <functional>
+#include <QList>
+#include <QThread>
+#include "types.h"
+#include "workers.h"
+
+/*
+ * Scores a measured spectrum against every element of a catalog.
+ * Elements are aligned independently on a worker pool, each one gets its
+ * own copy of the spectrum since alignment may write into it, and the
+ * outcome lands in the align_info of the element. Matching elements are
+ * ranked by score as they complete, those entering the best k are handed
+ * to the found callback right away, from the worker that aligned them,
+ * so large catalogs report their first matches long before the last.
+ * match() polls the cancel callback before each element and returns the
+ * best k matches, best first. It is not reentrant, the Aligner is its
+ * only caller.
+ */
+class Matcher
+{
+    public:
+        typedef std::function<bool()> cancel_func;
+        typedef std::function<void(dsp_stream_p element, int rank)> found_func;
+    private:
+        Workers workers;
+        std::mutex mutex;
+        Matcher() : workers(QThread::idealThreadCount()) {}
+    public:
+        Matcher(const Matcher&) = delete;
+        Matcher& operator=(const Matcher&) = delete;
+
+        static inline Matcher *instance()
+        {
+            static Matcher matcher;
+            return &matcher;
+        }
+        inline QList<dsp_stream_p> match(dsp_stream_p spectrum, const QList<dsp_stream_p> &elements, int k, int maxDots, int decimals,
+                                         int minScore, cancel_func cancelled, found_func found)
+        {
+            QList<dsp_stream_p> best;
+            workers.run(elements.count(), [&] (int x)
+            {
+                if(cancelled())
+                    return;
+                dsp_stream_p element = elements[x];
+                if(element->stars_count < 3)
+                    return;
+                dsp_stream_p probe = dsp_stream_copy(spectrum);
+                element->align_info = vlbi_astro_align_spectra(probe, element, maxDots, decimals, minScore);
+                dsp_stream_free_buffer(probe);
+                dsp_stream_free(probe);
+                if((element->align_info.err & DSP_ALIGN_NO_MATCH) != 0)
+                    return;
+                std::lock_guard<std::mutex> lock(mutex);
+                int rank = 0;
+                while(rank < best.count() && best[rank]->align_info.score <= element->align_info.score)
+                    rank++;
+                if(rank >= k)
+                    return;
+                best.insert(rank, element);
+                while(best.count() > k)
+                    best.removeLast();
+                found(element, rank);
+            });
+            return best;
+        }
+};
+
+#endif // MATCHER_H
@@ -0,0 +1,131 @@
+/*
+    MIT License
+
+    xc-gui GUI for libahp_xc and OpenVLBI using the AHP XC correlators
+    Copyright (C) 2020  Ilia Platone
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef PLANS_H
+#define PLANS_H
+
+#include <map>
+#include <algorithm>
+#include <tuple>
+#include <mutex>
+#include <thread>
+#include <QString>
+#include <fftw3.h>
+
+#define PLANS_THREADED_SIZE 65536
+
+/*
+ * FFTW plans cached by transform size, direction and threads.
+ * Forward plans are real to complex, backward ones complex to real, both
+ * out of place and unaligned so they run on any pair of buffers through
+ * the new array execute functions, which may be called from any thread.
+ * Plans are measured once and kept until clear(), the wisdom gathered
+ * is saved at shutdown and loaded back at startup so later runs find
+ * their plans without measuring again.
+ * libdsp and libvlbi plan with the same FFTW from other threads, so
+ * init() makes every FFTW planner thread safe. main() calls it before
+ * anything else can plan, the entry points below call it too.
+ */
+class Plans
+{
+    private:
+        typedef std::tuple<int, int, int> key;
+        static inline std::mutex *mutex()
+        {
+            static std::mutex m;
+            return &m;
+        }
+        static inline std::map<key, fftw_plan> *plans()
+        {
+            static std::map<key, fftw_plan> p;
+            return &p;
+        }
+        static inline void setup()
+        {
+            static bool initialized = false;
+            if(!initialized)
+            {
+                fftw_init_threads();
+                fftw_make_planner_thread_safe();
+                initialized = true;
+            }
+        }
+
+    public:
+        static inline void init()
+        {
+            std::lock_guard<std::mutex> lock(*mutex());
+            setup();
+        }
+        static inline int threads(int size)
+        {
+            if(size >= PLANS_THREADED_SIZE)
+                return std::max(1u, std::thread::hardware_concurrency());
+            return 1;
+        }
+        static inline fftw_plan get(int size, int sign, int nthreads = 1)
+        {
+            std::lock_guard<std::mutex> lock(*mutex());
+            setup();
+            key k(size, sign, nthreads);
+            auto it = plans()->find(k);
+            if(it != plans()->end())
+                return it->second;
+            fftw_plan_with_nthreads(nthreads);
+            double *real = fftw_alloc_real(size);
+            fftw_complex *complex = fftw_alloc_complex(size / 2 + 1);
+            fftw_plan plan;
+            if(sign == FFTW_FORWARD)
+                plan = fftw_plan_dft_r2c_1d(size, real, complex, FFTW_MEASURE | FFTW_UNALIGNED);
+            else
+                plan = fftw_plan_dft_c2r_1d(size, complex, real, FFTW_MEASURE | FFTW_UNALIGNED);
+            fftw_free(real);
+            fftw_free(complex);
+            if(plan != nullptr)
+                (*plans())[k] = plan;
+            return plan;
+        }
+        static inline void clear()
+        {
+            std::lock_guard<std::mutex> lock(*mutex());
+            for(auto it : *plans())
+                fftw_destroy_plan(it.second);
+            plans()->clear();
+        }
+        static inline bool loadWisdom(QString filename)
+        {
+            std::lock_guard<std::mutex> lock(*mutex());
+            setup();
+            return fftw_import_wisdom_from_filename(filename.toStdString().c_str()) != 0;
+        }
+        static inline bool saveWisdom(QString filename)
+        {
+            std::lock_guard<std::mutex> lock(*mutex());
+            setup();
+            return fftw_export_wisdom_to_filename(filename.toStdString().c_str()) != 0;
+        }
+};
+
+#endif // PLANS_H
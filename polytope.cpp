@@ -51,12 +51,15 @@ Polytope::Polytope(QString n, int index, QList<Line *>nodes, QSettings *s, QWidg
     lag_size = (double*)malloc(sizeof(double));
     spectrum = new Series();
     counts = new Series();
+    getSpectrum()->setDecay(readDouble("StackDecay", 0.0));
+    getCounts()->setMemoryBudget(readDouble("MemoryBudget", SERIES_MEMORY_BUDGET));
+    getCounts()->setDiskBudget(readDouble("DiskBudget", SERIES_DISK_BUDGET));
     resetPercentPtr();
     resetStopPtr();
     stream = dsp_stream_new();
     dsp_stream_add_dim(stream, 1);
     dsp_stream_alloc_buffer(stream, stream->len);
-    stream->samplerate = 1.0/ahp_xc_get_packettime();
+    setPacketTime(ahp_xc_get_packettime());
     connect(getSpectrum()->getElemental(), static_cast<void (Elemental::*)(bool, double, double)>(&Elemental::scanFinished), this, &Polytope::plot);
 }
 
@@ -115,7 +118,7 @@ void Polytope::setDelay(double s)
 void Polytope::setMode(Mode m)
 {
     mode = m;
-    getDark()->clear();
+    getSpectrum()->clearDark();
     getCounts()->clear();
     getSpectrum()->clear();
     if(mode == CrosscorrelatorIQ || mode == CrosscorrelatorII)
@@ -141,7 +144,11 @@ void Polytope::addCount(double starttime, ahp_xc_packet *packet)
 {
     if(packet == nullptr)
         packet = getPacket();
-    bool active = false;
+    addCount(starttime, &packet, 1);
+}
+
+void Polytope::steer(double starttime, ahp_xc_packet **packets, size_t npackets)
+{
     switch(getMode()) {
     default: break;
     case HolographIQ:
@@ -152,31 +159,43 @@ void Polytope::addCount(double starttime, ahp_xc_packet *packet)
             dsp_stream_p stream = getStream();
             if(stream == nullptr) break;
             if(MainWindow::lock_vlbi()) {
-                double offset = 0;
-                for(int x = 0; x < getCorrelationOrder(); x++) {
-                    if(vlbi_has_node(getVLBIContext(), getLine(x)->getName().toStdString().c_str())) {
-                        offset = vlbi_get_offset(getVLBIContext(), packet->timestamp + starttime, getLine(x)->getName().toStdString().c_str(),
-                                         getGraph()->getRa(), getGraph()->getDec(), getGraph()->getDistance());
-                        offset /= ahp_xc_get_sampletime();
-                        offset ++;
-                        if(ahp_xc_intensity_crosscorrelator_enabled())
-                        {
-                            ahp_xc_set_channel_auto(getLine(x)->getLineIndex(), offset, 1, 0);
-                        } else {
-                            ahp_xc_set_channel_cross(getLine(x)->getLineIndex(), offset, 1, 0);
+                for(size_t n = 0; n < npackets; n++) {
+                    ahp_xc_packet *packet = packets[n];
+                    double offset = 0;
+                    // captures and the emulator have no delay lines to steer
+                    for(int x = 0; x < getCorrelationOrder() && source == nullptr; x++) {
+                        if(vlbi_has_node(getVLBIContext(), getLine(x)->getName().toStdString().c_str())) {
+                            offset = vlbi_get_offset(getVLBIContext(), packet->timestamp + starttime, getLine(x)->getName().toStdString().c_str(),
+                                             getGraph()->getRa(), getGraph()->getDec(), getGraph()->getDistance());
+                            offset /= ahp_xc_get_sampletime();
+                            offset ++;
+                            if(ahp_xc_intensity_crosscorrelator_enabled())
+                            {
+                                ahp_xc_set_channel_auto(getLine(x)->getLineIndex(), offset, 1, 0);
+                            } else {
+                                ahp_xc_set_channel_cross(getLine(x)->getLineIndex(), offset, 1, 0);
+                            }
                         }
                     }
+                    stream->dft.complex[0].real = packet->crosscorrelations[Index].correlations[crossLagSize() / 2].real;
+                    stream->dft.complex[0].imaginary = packet->crosscorrelations[Index].correlations[crossLagSize() / 2].imaginary;
                 }
-                stream->dft.complex[0].real = packet->crosscorrelations[Index].correlations[ahp_xc_get_crosscorrelator_lagsize() / 2].real;
-                stream->dft.complex[0].imaginary = packet->crosscorrelations[Index].correlations[ahp_xc_get_crosscorrelator_lagsize() / 2].imaginary;
                 MainWindow::unlock_vlbi();
             }
         }
         break;
+    }
+}
+
+void Polytope::addCount(double starttime, ahp_xc_packet **packets, size_t npackets)
+{
+    bool active = false;
+    switch(getMode()) {
+    default: break;
     case Counter:
         if(isActive())
         {
-            int index = ahp_xc_get_crosscorrelation_index(indexes.toVector().toStdVector().data(), indexes.count());
+            int index = baselineIndex();
             active = Index == index;
             bool showhistogram = true;
             for(int x = 0; x < getCorrelationOrder(); x++) {
@@ -186,37 +205,41 @@ void Polytope::addCount(double starttime, ahp_xc_packet *packet)
                     showhistogram &= false;
             }
             if(active) {
-                double mag = -1.0;
-                double phi = -1.0;
-                if(ahp_xc_intensity_crosscorrelator_enabled()) {
-                    mag = 0.0;
-                    phi = 0.0;
-                    double cr = 0;
-                    double ci = 0;
-                    for(int x = 0; x < getCorrelationOrder(); x++) {
-                        double rad_p = (phi+packet->autocorrelations[getLine(x)->getLineIndex()].correlations[0].phase)/2.0;
-                        double rad_m = (phi-packet->autocorrelations[getLine(x)->getLineIndex()].correlations[0].phase)/2.0;
-                        mag += packet->autocorrelations[getLine(x)->getLineIndex()].correlations[0].magnitude;
-                        cr = 2*sin(rad_p)*cos(rad_m);
-                        ci = 2*cos(rad_p)*cos(rad_m);
+                bool intensity = source == nullptr && ahp_xc_intensity_crosscorrelator_enabled();
+                double packettime = getPacketTime();
+                for(size_t n = 0; n < npackets; n++) {
+                    ahp_xc_packet *packet = packets[n];
+                    double mag = -1.0;
+                    double phi = -1.0;
+                    if(intensity) {
+                        mag = 0.0;
+                        phi = 0.0;
+                        double cr = 0;
+                        double ci = 0;
+                        for(int x = 0; x < getCorrelationOrder(); x++) {
+                            double rad_p = (phi+packet->autocorrelations[getLine(x)->getLineIndex()].correlations[0].phase)/2.0;
+                            double rad_m = (phi-packet->autocorrelations[getLine(x)->getLineIndex()].correlations[0].phase)/2.0;
+                            mag += packet->autocorrelations[getLine(x)->getLineIndex()].correlations[0].magnitude;
+                            cr = 2*sin(rad_p)*cos(rad_m);
+                            ci = 2*cos(rad_p)*cos(rad_m);
+                        }
+                        mag /= getCorrelationOrder();
+                        phi = asin(cr);
+                        if(ci < 0) phi += M_PI;
+                        cr *= mag;
+                        ci *= mag;
+                        double side = cr + ci;
+                        mag = sqrt(pow(cr, 2)+pow(ci, 2)) / packettime / side;
+                    } else {
+                        double side = (double)packet->crosscorrelations[Index].correlations[0].real + (double)packet->crosscorrelations[Index].correlations[0].imaginary;
+                        mag = (double)packet->crosscorrelations[Index].correlations[0].magnitude / packettime / side;
+                        phi = (double)packet->crosscorrelations[Index].correlations[0].phase;
                     }
-                    mag /= getCorrelationOrder();
-                    phi = asin(cr);
-                    if(ci < 0) phi += M_PI;
-                    cr *= mag;
-                    ci *= mag;
-                    double side = cr + ci;
-                    mag = sqrt(pow(cr, 2)+pow(ci, 2)) / ahp_xc_get_packettime() / side;
-                } else {
-                    double side = (double)packet->crosscorrelations[Index].correlations[0].real + (double)packet->crosscorrelations[Index].correlations[0].imaginary;
-                    mag = (double)packet->crosscorrelations[Index].correlations[0].magnitude / ahp_xc_get_packettime() / side;
-                    phi = (double)packet->crosscorrelations[Index].correlations[0].phase;
-                }
-                getCounts()->getElemental()->setStreamSize(getCounts()->getSeries()->count()+1);
-                getCounts()->addCount(packet->timestamp + starttime - getTimeRange(), packet->timestamp + starttime, -1.0, mag, phi);
-                if(showhistogram) {
-                    getCounts()->buildHistogram(getCounts()->getMagnitude(), getCounts()->getElemental()->getStream()->magnitude, 100, getCounts()->getHistogramStackIndexMagnitude(), getCounts()->getHistogramStackMagnitude(), getCounts()->getHistogramMagnitude());
+                    getCounts()->addCount(packet->timestamp + starttime - getTimeRange(), packet->timestamp + starttime, -1.0, mag, phi);
                 }
+                getCounts()->setHistogram(100, false, showhistogram);
+                if(showhistogram)
+                    Latency::record(Latency::Histogram, Latency::origin());
             }
             else
             {
@@ -227,10 +250,28 @@ void Polytope::addCount(double starttime, ahp_xc_packet *packet)
     }
 }
 
+int Polytope::lineIndex(int order)
+{
+    if(source != nullptr)
+        return Source::lineIndex(source->getHeader()->nlines, Index, order);
+    return ahp_xc_get_line_index(Index, order);
+}
+
+int Polytope::baselineIndex()
+{
+    QVector<int> idx = indexes.toVector();
+    if(source != nullptr)
+        return Source::baselineIndex(source->getHeader()->nlines, idx.data(), idx.count());
+    return ahp_xc_get_crosscorrelation_index(idx.toStdVector().data(), idx.count());
+}
+
 void Polytope::setCorrelationOrder(int order)
 {
     while(!MainWindow::lock_vlbi());
     correlation_order = fmax(order, 2);
+    // a capture or an emulated correlator carries pairwise baselines only
+    if(source != nullptr)
+        correlation_order = 2;
     start = (int*)realloc(start, sizeof(int) * correlation_order);
     end = (int*)realloc(end, sizeof(int) * correlation_order);
     step = (int*)realloc(step, sizeof(int) * correlation_order);
@@ -242,7 +283,7 @@ void Polytope::setCorrelationOrder(int order)
     lines.clear();
     indexes.clear();
     for(int x = 0; x < correlation_order; x++) {
-        int idx = ahp_xc_get_line_index(Index, x);
+        int idx = lineIndex(x);
         lines.append(Nodes.at(idx));
         indexes.append(idx);
     }
@@ -255,7 +296,7 @@ void Polytope::setCorrelationOrder(int order)
     lines.clear();
     indexes.clear();
     for(int x = 0; x < getCorrelationOrder(); x++) {
-        int idx = ahp_xc_get_line_index(Index, x);
+        int idx = lineIndex(x);
         lines.append(Nodes[idx]);
         indexes.append(idx);
         connect(getLine(x), static_cast<void (Line::*)()>(&Line::clear),
@@ -277,6 +318,7 @@ void Polytope::setCorrelationOrder(int order)
                 if(line != nullptr)
                 *stop = (*stop || !line->isRunning());
             }
+            running = newstate;
             if(oldstate != newstate)
             {
                 emit activeStateChanging(this);
@@ -285,7 +327,6 @@ void Polytope::setCorrelationOrder(int order)
                     emit activeStateChanged(this);
                 }
             }
-            running = newstate;
             oldstate = newstate;
         });
         getLine(x)->setActive(getLine(x)->isActive());
@@ -349,12 +390,10 @@ void Polytope::TakeMeanValue(Line *sender)
     {
         MinValue = 0;
     } else {
-        double min = DBL_MAX;
-        for(int d = 0; d < getCounts()->getMagnitude()->count(); d++)
-        {
-            min = fmin(min, getCounts()->getMagnitude()->at(d).y());
-        }
-        MinValue = min;
+        getCounts()->getColumns()->lock();
+        double min = getCounts()->getStatistics(Series::MagnitudeColumn)->getMin();
+        getCounts()->getColumns()->unlock();
+        MinValue = std::isfinite(min) ? min : DBL_MAX;
     }
 }
 
@@ -362,15 +401,15 @@ void Polytope::TakeDark(Line* sender)
 {
     if(sender->DarkTaken())
     {
-        getDark()->clear();
+        getSpectrum()->clearDark();
         for(int x = 0; x < getSpectrum()->count(); x++)
         {
-            getDark()->insert(getSpectrum()->getMagnitude()->at(x).x(), getSpectrum()->getMagnitude()->at(x).y());
+            getSpectrum()->addDark(getSpectrum()->getMagnitudePoints()->at(x).x(), getSpectrum()->getMagnitudePoints()->at(x).y());
             QString darkstring = readString("Dark", "");
             if(!darkstring.isEmpty())
                 saveSetting("Dark", darkstring + ";");
             darkstring = readString("Dark", "");
-            saveSetting("Dark", darkstring + QString::number(getSpectrum()->getMagnitude()->at(x).x()) + "," + QString::number(getSpectrum()->getMagnitude()->at(
+            saveSetting("Dark", darkstring + QString::number(getSpectrum()->getMagnitudePoints()->at(x).x()) + "," + QString::number(getSpectrum()->getMagnitudePoints()->at(
                             x).y()));
         }
         getSpectrum()->setName(name + " magnitude (residuals)");
@@ -378,7 +417,7 @@ void Polytope::TakeDark(Line* sender)
     else
     {
         removeSetting("Dark");
-        getDark()->clear();
+        getSpectrum()->clearDark();
         getSpectrum()->setName(name + " magnitude");
     }
 }
@@ -396,8 +435,8 @@ void Polytope::SavePlot()
         output << "'lag (ns)';'magnitude';'phase'\n";
         for(int x = 0, y = 0; x < getSpectrum()->count(); y++, x++)
         {
-            output << "'" + QString::number(getSpectrum()->getMagnitude()->at(y).x()) + "';'" + QString::number(getSpectrum()->getMagnitude()->at(y).y()) + "';'"
-                   + QString::number(getSpectrum()->getPhase()->at(y).x()) + "';'" + QString::number(getSpectrum()->getPhase()->at(y).y()) + "'\n";
+            output << "'" + QString::number(getSpectrum()->getMagnitudePoints()->at(y).x()) + "';'" + QString::number(getSpectrum()->getMagnitudePoints()->at(y).y()) + "';'"
+                   + QString::number(getSpectrum()->getPhasePoints()->at(y).x()) + "';'" + QString::number(getSpectrum()->getPhasePoints()->at(y).y()) + "'\n";
         }
     }
     data.close();
@@ -418,11 +457,6 @@ int Polytope::smooth()
     return value;
 }
 
-QMap<double, double>* Polytope::getDark()
-{
-    return getCounts()->getDark();
-}
-
 void Polytope::stackCorrelations()
 {
     scanning = true;
@@ -485,8 +519,10 @@ void Polytope::stackCorrelations()
             getSpectrum()->getElemental()->idft();
         if(align)
             getSpectrum()->getElemental()->run();
-        else
+        else {
+            getSpectrum()->getElemental()->publish();
             getSpectrum()->getElemental()->finish(false, getStartLag(), getLagStep());
+        }
         free(spectrum);
     }
     for(Line* line : getLines()) {
@@ -498,19 +534,21 @@ void Polytope::stackCorrelations()
 
 void Polytope::plot(bool success, double o, double s)
 {
-    double timespan = s;
-    if(success)
-        timespan = s;
-    double x_offset = o;
+    Elemental::Result aligned = getSpectrum()->getElemental()->alignment();
+    if(aligned == nullptr || aligned->spectrum == nullptr)
+        return;
+    double timespan = aligned->scale;
+    double x_offset = aligned->offset;
     double y_offset = 0;
+    Elemental::Snapshot spectrum = aligned->spectrum;
     getSpectrum()->reset();
     if(!idft()) {
-        getSpectrum()->stackBuffer(getSpectrum()->getMagnitude(), getSpectrum()->getMagnitudeStack(), getSpectrum()->getElemental()->getMagnitude(), 0, getSpectrum()->getElemental()->getStreamSize(), timespan, x_offset, 1.0, y_offset);
-        getSpectrum()->stackBuffer(getSpectrum()->getPhase(), getSpectrum()->getPhaseStack(), getSpectrum()->getElemental()->getPhase(), 0, getSpectrum()->getElemental()->getStreamSize(), timespan, x_offset, 1.0, y_offset);
+        getSpectrum()->stackBuffer(getSpectrum()->getMagnitude(), getSpectrum()->getMagnitudeStack(), spectrum->stream->magnitude->buf, 0, spectrum->stream->len, timespan, x_offset, 1.0, y_offset, getSpectrum()->getBand());
+        getSpectrum()->stackBuffer(getSpectrum()->getPhase(), getSpectrum()->getPhaseStack(), spectrum->stream->phase->buf, 0, spectrum->stream->len, timespan, x_offset, 1.0, y_offset);
     } else
-        getSpectrum()->stackBuffer(getSpectrum()->getMagnitude(), getSpectrum()->getStack(), getSpectrum()->getElemental()->getBuffer(), 0, getSpectrum()->getElemental()->getStreamSize(), timespan, x_offset, 1.0, y_offset);
-    getSpectrum()->buildHistogram(getSpectrum()->getMagnitude(), getSpectrum()->getElemental()->getStream()->magnitude, 100, getSpectrum()->getHistogramStackIndexMagnitude(), getSpectrum()->getHistogramStackMagnitude(), getSpectrum()->getHistogramMagnitude());
-    getSpectrum()->buildHistogram(getSpectrum()->getPhase(), getSpectrum()->getElemental()->getStream()->phase, 100, getSpectrum()->getHistogramStackIndexPhase(), getSpectrum()->getHistogramStackPhase(), getSpectrum()->getHistogramPhase());
+        getSpectrum()->stackBuffer(getSpectrum()->getMagnitude(), getSpectrum()->getStack(), spectrum->stream->buf, 0, spectrum->stream->len, timespan, x_offset, 1.0, y_offset, getSpectrum()->getBand());
+    getSpectrum()->buildHistogram(getSpectrum()->getMagnitude(), 100, getSpectrum()->getHistogramStackIndexMagnitude(), getSpectrum()->getHistogramStackMagnitude(), getSpectrum()->getHistogramMagnitude());
+    getSpectrum()->buildHistogram(getSpectrum()->getPhase(), 100, getSpectrum()->getHistogramStackIndexPhase(), getSpectrum()->getHistogramStackPhase(), getSpectrum()->getHistogramPhase());
     getGraph()->paint3d();
     gethistogram()->paint();
 }
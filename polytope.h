@@ -40,6 +40,7 @@
 #include "series.h"
 #include "types.h"
 #include "elemental.h"
+#include "source.h"
 
 using namespace QtCharts;
 class Line;
@@ -76,7 +77,6 @@ class Polytope : public QWidget
         {
             return getSpectrum()->getElemental()->getStreamSize();
         }
-        QMap<double, double>* getDark();
         void setMode(Mode m);
         inline Mode getMode()
         {
@@ -119,6 +119,10 @@ class Polytope : public QWidget
         {
             return lines;
         }
+        inline void setSource(Source *s)
+        {
+            source = s;
+        }
         void setCorrelationOrder(int order);
         inline int getCorrelationOrder()
         {
@@ -187,7 +191,15 @@ class Polytope : public QWidget
             mutex.unlock();
         }
         inline double getPacketTime() { return packetTime; }
+        inline void setPacketTime(double time)
+        {
+            packetTime = time;
+            stream->samplerate = 1.0/packetTime;
+            getCounts()->setPacketTime(packetTime);
+        }
         void addCount(double starttime, ahp_xc_packet *packet = nullptr);
+        void addCount(double starttime, ahp_xc_packet **packets, size_t count);
+        void steer(double starttime, ahp_xc_packet **packets, size_t count);
         inline double getTimeRange() { return timeRange; }
         inline void setTimeRange(double range) { timeRange = range; }
         inline ahp_xc_packet* getPacket() { return packet; }
@@ -233,13 +245,19 @@ class Polytope : public QWidget
         void stretch(Series* series);
 
         dsp_stream_p stream { nullptr };
-        fftw_plan plan;
         double MinValue { 0.0 };
         size_t magnitude_size { 0 };
         size_t phase_size { 0 };
         double offset { 0.0 };
         double timespan { 1.0 };
         int Index;
+        Source *source { nullptr };
+        int lineIndex(int order);
+        int baselineIndex();
+        inline unsigned int crossLagSize()
+        {
+            return (source != nullptr) ? source->getHeader()->crosslag : ahp_xc_get_crosscorrelator_lagsize();
+        }
         int *start;
         int *end;
         int *step;
@@ -0,0 +1,160 @@
+/*
+    MIT License
+
+    xc-gui GUI for libahp_xc and OpenVLBI using the AHP XC correlators
+    Copyright (C) 2020  Ilia Platone
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <QHash>
+#include <ahp_xc.h>
+
+/*
+ * Fixed set of preallocated packets recycled in place.
+ * acquire() hands out a free packet holding one reference, consumers that
+ * need to keep a packet beyond the dispatch call take another one with
+ * ref() and drop it with release(). A packet returns to the pool when its
+ * last reference is released, nothing is allocated after alloc().
+ * Packets come from libahp_xc unless another allocator is given, each
+ * one carries the time it was read for latency accounting. The released
+ * callback runs whenever a packet goes back to the pool.
+ */
+class PacketPool
+{
+    public:
+        typedef std::function<ahp_xc_packet*()> alloc_func;
+        typedef std::function<void(ahp_xc_packet*)> free_func;
+        typedef std::function<void()> notify_func;
+    private:
+        typedef struct
+        {
+            ahp_xc_packet *packet;
+            std::atomic<int> refs;
+            qint64 stamp;
+        } entry;
+        entry *entries { nullptr };
+        size_t size { 0 };
+        size_t next { 0 };
+        QHash<ahp_xc_packet*, entry*> index;
+        free_func deallocate;
+        notify_func released;
+    public:
+        PacketPool() {}
+        ~PacketPool()
+        {
+            free();
+        }
+        PacketPool(const PacketPool&) = delete;
+        PacketPool& operator=(const PacketPool&) = delete;
+
+        static inline size_t packetSize(size_t nlines, size_t nbaselines, size_t autolag, size_t crosslag)
+        {
+            size_t autolen = sizeof(ahp_xc_sample) + sizeof(ahp_xc_correlation) * autolag;
+            size_t crosslen = sizeof(ahp_xc_sample) + sizeof(ahp_xc_correlation) * crosslag;
+            return sizeof(ahp_xc_packet) + nlines * (sizeof(unsigned long) + autolen) + nbaselines * crosslen;
+        }
+        static inline size_t packetSize()
+        {
+            return packetSize(ahp_xc_get_nlines(), ahp_xc_get_nbaselines(), ahp_xc_get_autocorrelator_lagsize(), ahp_xc_get_crosscorrelator_lagsize());
+        }
+        inline void alloc(size_t count, alloc_func allocate = ahp_xc_alloc_packet, free_func release = ahp_xc_free_packet)
+        {
+            free();
+            entries = new entry[count];
+            size = count;
+            next = 0;
+            deallocate = release;
+            for(size_t x = 0; x < size; x++)
+            {
+                entries[x].packet = allocate();
+                entries[x].refs.store(0);
+                entries[x].stamp = 0;
+                index.insert(entries[x].packet, &entries[x]);
+            }
+        }
+        inline void free()
+        {
+            for(size_t x = 0; x < size; x++)
+                deallocate(entries[x].packet);
+            delete[] entries;
+            entries = nullptr;
+            size = 0;
+            index.clear();
+        }
+        inline size_t count()
+        {
+            return size;
+        }
+        inline size_t available()
+        {
+            size_t n = 0;
+            for(size_t x = 0; x < size; x++)
+                n += entries[x].refs.load(std::memory_order_relaxed) == 0;
+            return n;
+        }
+        inline ahp_xc_packet *acquire()
+        {
+            for(size_t x = 0; x < size; x++)
+            {
+                entry *e = &entries[next];
+                next = (next + 1) % size;
+                int expected = 0;
+                if(e->refs.compare_exchange_strong(expected, 1, std::memory_order_acquire))
+                    return e->packet;
+            }
+            return nullptr;
+        }
+        inline ahp_xc_packet *ref(ahp_xc_packet *packet)
+        {
+            entry *e = index.value(packet, nullptr);
+            if(e != nullptr)
+                e->refs.fetch_add(1, std::memory_order_relaxed);
+            return packet;
+        }
+        inline void setStamp(ahp_xc_packet *packet, qint64 stamp)
+        {
+            entry *e = index.value(packet, nullptr);
+            if(e != nullptr)
+                e->stamp = stamp;
+        }
+        inline qint64 getStamp(ahp_xc_packet *packet)
+        {
+            entry *e = index.value(packet, nullptr);
+            return (e != nullptr) ? e->stamp : 0;
+        }
+        inline void setReleased(notify_func notify)
+        {
+            released = notify;
+        }
+        inline void release(ahp_xc_packet *packet)
+        {
+            entry *e = index.value(packet, nullptr);
+            if(e != nullptr && e->refs.fetch_sub(1, std::memory_order_release) == 1 && released)
+                released();
+        }
+};
+
+#endif // POOL_H
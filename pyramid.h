@@ -0,0 +1,223 @@
+/*
+    MIT License
+
+    xc-gui GUI for libahp_xc and OpenVLBI using the AHP XC correlators
+    Copyright (C) 2020  Ilia Platone
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef PYRAMID_H
+#define PYRAMID_H
+
+#include <cmath>
+#include <QList>
+#include <QMutex>
+#include <QPointF>
+#include <QVector>
+
+#define PYRAMID_BUCKETS 4096
+#define PYRAMID_FACTOR 10
+#define PYRAMID_LEVELS 16
+
+/*
+ * Level of detail pyramid of a time series.
+ * Level k holds the min, max and mean of buckets PYRAMID_FACTOR^k packet
+ * times wide in a ring of PYRAMID_BUCKETS entries. Every sample updates the
+ * open bucket of each level. A coarser level is added from the top one
+ * only when the top ring would start dropping buckets, so memory grows
+ * with the logarithm of the run length.
+ */
+class Pyramid
+{
+    public:
+        struct Bucket
+        {
+            qint64 index;
+            double min;
+            double max;
+            double sum;
+            int count;
+            inline double mean() const
+            {
+                return sum / count;
+            }
+        };
+
+    private:
+        struct Level
+        {
+            double width;
+            QVector<Bucket> buckets;
+            int head;
+            int size;
+            inline Bucket &at(int i)
+            {
+                return buckets[(head + i) % buckets.count()];
+            }
+            inline Bucket &last()
+            {
+                return at(size - 1);
+            }
+            inline bool full()
+            {
+                return size == buckets.count();
+            }
+            inline void insert(qint64 index, double mn, double mx, double sum, int count)
+            {
+                if(size > 0 && last().index == index) {
+                    Bucket &b = last();
+                    b.min = fmin(b.min, mn);
+                    b.max = fmax(b.max, mx);
+                    b.sum += sum;
+                    b.count += count;
+                    return;
+                }
+                if(full()) {
+                    head = (head + 1) % buckets.count();
+                    size--;
+                }
+                Bucket &b = at(size++);
+                b.index = index;
+                b.min = mn;
+                b.max = mx;
+                b.sum = sum;
+                b.count = count;
+            }
+        };
+        QList<Level> levels;
+        double base { 0.0 };
+        double last_x { 0.0 };
+        bool changed { false };
+        QMutex mutex;
+
+        void addLevel(double width)
+        {
+            Level level;
+            level.width = width;
+            level.buckets.resize(PYRAMID_BUCKETS);
+            level.head = 0;
+            level.size = 0;
+            if(!levels.isEmpty()) {
+                Level &top = levels.last();
+                for(int x = 0; x < top.size; x++) {
+                    const Bucket &b = top.at(x);
+                    level.insert((qint64)floor(b.index * top.width / width), b.min, b.max, b.sum, b.count);
+                }
+            }
+            levels.append(level);
+        }
+
+    public:
+        Pyramid() {}
+        Pyramid(const Pyramid&) = delete;
+        Pyramid& operator=(const Pyramid&) = delete;
+
+        void lock()
+        {
+            mutex.lock();
+        }
+        void unlock()
+        {
+            mutex.unlock();
+        }
+        inline int count()
+        {
+            return levels.count();
+        }
+        inline double lastTime()
+        {
+            return last_x;
+        }
+        // the finest bucket width, changing it drops the pyramid
+        void setBase(double width)
+        {
+            lock();
+            if(width != base) {
+                levels.clear();
+                base = width;
+                changed = true;
+            }
+            unlock();
+        }
+        void clear()
+        {
+            lock();
+            levels.clear();
+            changed = true;
+            unlock();
+        }
+        void add(double x, double y)
+        {
+            if(base <= 0.0 || !std::isfinite(y))
+                return;
+            lock();
+            if(levels.isEmpty())
+                addLevel(base);
+            Level &top = levels.last();
+            if(top.full() && top.last().index != (qint64)floor(x / top.width) && levels.count() < PYRAMID_LEVELS)
+                addLevel(top.width * PYRAMID_FACTOR);
+            for(int l = 0; l < levels.count(); l++)
+                levels[l].insert((qint64)floor(x / levels[l].width), y, y, y, 1);
+            last_x = x;
+            changed = true;
+            unlock();
+        }
+        // returns whether the pyramid changed since the previous call
+        inline bool takeChanged()
+        {
+            lock();
+            bool c = changed;
+            changed = false;
+            unlock();
+            return c;
+        }
+        /*
+         * Fills out with the min and max of each bucket between x0 and x1,
+         * taken from the finest level that still holds x0 and spans the range
+         * in at most budget buckets.
+         */
+        void query(double x0, double x1, int budget, QVector<QPointF> &out)
+        {
+            out.clear();
+            lock();
+            int l = 0;
+            for(; l < levels.count() - 1; l++) {
+                Level &level = levels[l];
+                bool covers = level.size > 0 && level.at(0).index * level.width <= x0;
+                if(covers && (x1 - x0) / level.width <= budget)
+                    break;
+            }
+            if(l < levels.count()) {
+                Level &level = levels[l];
+                for(int x = 0; x < level.size; x++) {
+                    const Bucket &b = level.at(x);
+                    double t = (b.index + 0.5) * level.width;
+                    if(t < x0 || t > x1)
+                        continue;
+                    out.append(QPointF(t, b.min));
+                    if(b.max != b.min)
+                        out.append(QPointF(t, b.max));
+                }
+            }
+            unlock();
+        }
+};
+
+#endif // PYRAMID_H
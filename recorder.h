@@ -0,0 +1,246 @@
+/*
+    MIT License
+
+    xc-gui GUI for libahp_xc and OpenVLBI using the AHP XC correlators
+    Copyright (C) 2020  Ilia Platone
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <cstring>
+#include <cstddef>
+#include <QFile>
+#include <QMutex>
+#include <QString>
+#include <ahp_xc.h>
+
+#define RECORDER_MAGIC "AHPXCREC"
+#define RECORDER_VERSION 1
+#define RECORDER_SEGMENT_SIZE (64 << 20)
+#define RECORDER_INDEX_STRIDE 1024
+
+/*
+ * Append-only raw capture of every packet.
+ * The file starts with a fixed header followed by fixed size records:
+ * timestamp, counts of each line, autocorrelations of each line and
+ * crosscorrelations of each baseline, correlations stored as raw
+ * ahp_xc_correlation structures. The file grows by whole segments which
+ * are mapped in memory and filled with memcpy, it is trimmed to the
+ * recorded length on close. One timestamp every index_stride records is
+ * appended to a sidecar .idx file for seeking, the record count in the
+ * header is brought up to date at the same time so a capture cut short
+ * by a crash still tells how much of it was written.
+ */
+class Recorder
+{
+    public:
+        typedef struct
+        {
+            char magic[8];
+            quint32 version;
+            quint32 header_size;
+            char device[64];
+            quint32 nlines;
+            quint32 nbaselines;
+            quint32 autolag;
+            quint32 crosslag;
+            quint32 correlation_size;
+            quint32 record_size;
+            double packettime;
+            double starttime;
+            quint64 index_stride;
+            quint64 records;
+        } Header;
+        typedef struct
+        {
+            double timestamp;
+            quint64 record;
+        } IndexEntry;
+
+        static inline size_t recordSize(quint32 nlines, quint32 nbaselines, quint32 autolag, quint32 crosslag)
+        {
+            return sizeof(double) + nlines * sizeof(quint64) + (nlines * autolag + nbaselines * crosslag) * sizeof(ahp_xc_correlation);
+        }
+
+    private:
+        QFile file;
+        QFile index;
+        QMutex mutex;
+        Header header;
+        Header *head { nullptr };
+        uchar *segment { nullptr };
+        qint64 segment_offset { 0 };
+        qint64 segment_pos { 0 };
+        bool recording { false };
+
+        inline bool nextSegment()
+        {
+            if(segment != nullptr)
+            {
+                file.unmap(segment);
+                segment = nullptr;
+                segment_offset += RECORDER_SEGMENT_SIZE;
+            }
+            if(!file.resize(segment_offset + RECORDER_SEGMENT_SIZE))
+                return false;
+            segment = file.map(segment_offset, RECORDER_SEGMENT_SIZE);
+            segment_pos = 0;
+            return segment != nullptr;
+        }
+        inline bool append(const void *data, size_t len)
+        {
+            const uchar *src = (const uchar*)data;
+            while(len > 0)
+            {
+                if(segment == nullptr || segment_pos == RECORDER_SEGMENT_SIZE)
+                {
+                    if(!nextSegment())
+                        return false;
+                }
+                size_t n = qMin((qint64)len, RECORDER_SEGMENT_SIZE - segment_pos);
+                memcpy(&segment[segment_pos], src, n);
+                segment_pos += n;
+                src += n;
+                len -= n;
+            }
+            return true;
+        }
+        inline void finish()
+        {
+            if(head != nullptr)
+                file.unmap((uchar*)head);
+            head = nullptr;
+            if(segment != nullptr)
+                file.unmap(segment);
+            segment = nullptr;
+            file.resize(header.header_size + header.records * header.record_size);
+            file.seek(offsetof(Header, records));
+            file.write((const char*)&header.records, sizeof(header.records));
+            file.close();
+            index.close();
+            recording = false;
+        }
+
+    public:
+        Recorder() {}
+        ~Recorder()
+        {
+            close();
+        }
+        Recorder(const Recorder&) = delete;
+        Recorder& operator=(const Recorder&) = delete;
+
+        inline bool open(QString filename, double starttime)
+        {
+            close();
+            mutex.lock();
+            memset(&header, 0, sizeof(Header));
+            memcpy(header.magic, RECORDER_MAGIC, sizeof(header.magic));
+            header.version = RECORDER_VERSION;
+            header.header_size = sizeof(Header);
+            strncpy(header.device, ahp_xc_get_header(), sizeof(header.device) - 1);
+            header.nlines = ahp_xc_get_nlines();
+            header.nbaselines = ahp_xc_get_nbaselines();
+            header.autolag = ahp_xc_get_autocorrelator_lagsize();
+            header.crosslag = ahp_xc_get_crosscorrelator_lagsize();
+            header.correlation_size = sizeof(ahp_xc_correlation);
+            header.record_size = recordSize(header.nlines, header.nbaselines, header.autolag, header.crosslag);
+            header.packettime = ahp_xc_get_packettime();
+            header.starttime = starttime;
+            header.index_stride = RECORDER_INDEX_STRIDE;
+            header.records = 0;
+            segment_offset = 0;
+            file.setFileName(filename);
+            index.setFileName(filename + ".idx");
+            recording = file.open(QIODevice::ReadWrite | QIODevice::Truncate) && index.open(QIODevice::WriteOnly | QIODevice::Truncate);
+            if(recording)
+                recording = append(&header, sizeof(Header));
+            if(recording)
+            {
+                head = (Header*)file.map(0, sizeof(Header));
+                recording = head != nullptr;
+            }
+            if(!recording)
+            {
+                file.close();
+                index.close();
+            }
+            mutex.unlock();
+            return recording;
+        }
+        inline void close()
+        {
+            mutex.lock();
+            if(recording)
+                finish();
+            mutex.unlock();
+        }
+        inline bool isRecording()
+        {
+            return recording;
+        }
+        inline quint64 records()
+        {
+            return header.records;
+        }
+        inline QString fileName()
+        {
+            return file.fileName();
+        }
+        inline void write(ahp_xc_packet **packets, size_t count)
+        {
+            mutex.lock();
+            for(size_t n = 0; n < count && recording; n++)
+            {
+                ahp_xc_packet *packet = packets[n];
+                bool ok = true;
+                ok &= append(&packet->timestamp, sizeof(double));
+                for(quint32 x = 0; x < header.nlines; x++)
+                {
+                    quint64 counts = packet->counts[x];
+                    ok &= append(&counts, sizeof(quint64));
+                }
+                for(quint32 x = 0; x < header.nlines; x++)
+                    ok &= append(packet->autocorrelations[x].correlations, header.autolag * sizeof(ahp_xc_correlation));
+                for(quint32 x = 0; x < header.nbaselines; x++)
+                    ok &= append(packet->crosscorrelations[x].correlations, header.crosslag * sizeof(ahp_xc_correlation));
+                if(!ok)
+                {
+                    finish();
+                    break;
+                }
+                bool stride = header.records % header.index_stride == 0;
+                if(stride)
+                {
+                    IndexEntry entry = { packet->timestamp, header.records };
+                    index.write((const char*)&entry, sizeof(IndexEntry));
+                    index.flush();
+                }
+                header.records++;
+                if(stride)
+                    head->records = header.records;
+            }
+            mutex.unlock();
+        }
+};
+
+#endif // RECORDER_H
@@ -0,0 +1,196 @@
+/*
+    MIT License
+
+    xc-gui GUI for libahp_xc and OpenVLBI using the AHP XC correlators
+    Copyright (C) 2020  Ilia Platone
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <cstring>
+#include <QFile>
+#include <QString>
+#include <QThread>
+#include <QElapsedTimer>
+#include <ahp_xc.h>
+#include "recorder.h"
+#include "source.h"
+
+/*
+ * Packet source reading back a capture written by Recorder.
+ * read() fills a packet from the next record, paced on the recorded
+ * timestamps at speed times real time, a speed of 0 replays as fast as
+ * the consumers allow.
+ * A capture that was not closed cleanly still carries the zeroed tail of
+ * its last segment, its length is then taken from the record count last
+ * flushed to the header and the .idx sidecar, extended over the records
+ * written after them, which are the ones with a timestamp.
+ */
+class Replay : public Source
+{
+    private:
+        QFile file;
+        uchar *data { nullptr };
+        quint64 records { 0 };
+        quint64 record { 0 };
+        double speed { 1.0 };
+        double first { 0.0 };
+        bool started { false };
+        QElapsedTimer clock;
+
+        inline double timestampAt(quint64 r)
+        {
+            double timestamp;
+            memcpy(&timestamp, &data[header.header_size + r * header.record_size], sizeof(double));
+            return timestamp;
+        }
+        inline quint64 recovered(quint64 limit)
+        {
+            quint64 known = header.records;
+            QFile index(file.fileName() + ".idx");
+            if(index.open(QIODevice::ReadOnly) && index.size() >= (qint64)sizeof(Recorder::IndexEntry))
+            {
+                Recorder::IndexEntry entry;
+                index.seek(index.size() / sizeof(Recorder::IndexEntry) * sizeof(Recorder::IndexEntry) - sizeof(Recorder::IndexEntry));
+                if(index.read((char*)&entry, sizeof(Recorder::IndexEntry)) == sizeof(Recorder::IndexEntry))
+                    known = qMax(known, entry.record + 1);
+            }
+            known = qMin(known, limit);
+            while(known < limit && timestampAt(known) != 0.0)
+                known++;
+            return known;
+        }
+
+    public:
+        Replay() {}
+        ~Replay()
+        {
+            close();
+        }
+
+        inline bool open(QString filename)
+        {
+            close();
+            file.setFileName(filename);
+            if(!file.open(QIODevice::ReadOnly))
+                return false;
+            if(file.size() >= (qint64)sizeof(Recorder::Header))
+                data = file.map(0, file.size());
+            if(data != nullptr)
+            {
+                memcpy(&header, data, sizeof(Recorder::Header));
+                if(!memcmp(header.magic, RECORDER_MAGIC, sizeof(header.magic)) &&
+                        header.version == RECORDER_VERSION &&
+                        header.header_size == sizeof(Recorder::Header) &&
+                        header.correlation_size == sizeof(ahp_xc_correlation) &&
+                        header.record_size == Recorder::recordSize(header.nlines, header.nbaselines, header.autolag, header.crosslag))
+                {
+                    records = (file.size() - header.header_size) / header.record_size;
+                    if(file.size() != (qint64)(header.header_size + header.records * header.record_size))
+                        records = recovered(records);
+                    rewind();
+                    return true;
+                }
+            }
+            close();
+            return false;
+        }
+        inline void close()
+        {
+            if(data != nullptr)
+                file.unmap(data);
+            data = nullptr;
+            file.close();
+            records = 0;
+            record = 0;
+        }
+        inline bool isOpen() override
+        {
+            return data != nullptr;
+        }
+        inline bool atEnd() override
+        {
+            return isOpen() && record >= records;
+        }
+        inline void rewind() override
+        {
+            record = 0;
+            started = false;
+        }
+        inline void setSpeed(double s) override
+        {
+            speed = s;
+            started = false;
+        }
+        inline double getSpeed()
+        {
+            return speed;
+        }
+        inline quint64 count()
+        {
+            return records;
+        }
+        inline int read(ahp_xc_packet *packet) override
+        {
+            if(atEnd() || !isOpen())
+                return -1;
+            const uchar *src = &data[header.header_size + record * header.record_size];
+            double timestamp;
+            memcpy(&timestamp, src, sizeof(double));
+            src += sizeof(double);
+            if(speed > 0.0)
+            {
+                if(!started)
+                {
+                    first = timestamp;
+                    clock.start();
+                    started = true;
+                }
+                qint64 due = (timestamp - first) * 1000000.0 / speed;
+                qint64 now = clock.nsecsElapsed() / 1000;
+                if(due > now)
+                    QThread::usleep(due - now);
+            }
+            packet->timestamp = timestamp;
+            for(quint32 x = 0; x < header.nlines; x++)
+            {
+                quint64 counts;
+                memcpy(&counts, src, sizeof(quint64));
+                packet->counts[x] = counts;
+                src += sizeof(quint64);
+            }
+            for(quint32 x = 0; x < header.nlines; x++)
+            {
+                memcpy(packet->autocorrelations[x].correlations, src, header.autolag * sizeof(ahp_xc_correlation));
+                src += header.autolag * sizeof(ahp_xc_correlation);
+            }
+            for(quint32 x = 0; x < header.nbaselines; x++)
+            {
+                memcpy(packet->crosscorrelations[x].correlations, src, header.crosslag * sizeof(ahp_xc_correlation));
+                src += header.crosslag * sizeof(ahp_xc_correlation);
+            }
+            record++;
+            return 0;
+        }
+};
+
+#endif // REPLAY_H
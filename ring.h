@@ -0,0 +1,110 @@
+/*
+    MIT License
+
+    xc-gui GUI for libahp_xc and OpenVLBI using the AHP XC correlators
+    Copyright (C) 2020  Ilia Platone
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef RING_H
+#define RING_H
+
+#include <atomic>
+#include <cstddef>
+
+/*
+ * Bounded single-producer/single-consumer ring.
+ * The producer fills the slot returned by back() and publishes it with push(),
+ * the consumer reads the slot returned by front() and releases it with pop().
+ * Neither side ever blocks or takes a lock.
+ */
+template <typename T>
+class Ring
+{
+    private:
+        T *slots { nullptr };
+        size_t mask { 0 };
+        alignas(64) std::atomic<size_t> head { 0 };
+        alignas(64) std::atomic<size_t> tail { 0 };
+    public:
+        Ring(size_t capacity = 1024)
+        {
+            size_t size = 1;
+            while(size < capacity)
+                size <<= 1;
+            slots = new T[size]();
+            mask = size - 1;
+        }
+        ~Ring()
+        {
+            delete[] slots;
+        }
+        Ring(const Ring&) = delete;
+        Ring& operator=(const Ring&) = delete;
+
+        inline size_t capacity()
+        {
+            return mask + 1;
+        }
+        inline size_t count()
+        {
+            return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+        }
+        inline bool isEmpty()
+        {
+            return count() == 0;
+        }
+        inline bool isFull()
+        {
+            return count() > mask;
+        }
+        inline T *at(size_t index)
+        {
+            return &slots[index & mask];
+        }
+        inline T *back()
+        {
+            size_t h = head.load(std::memory_order_relaxed);
+            if(h - tail.load(std::memory_order_acquire) > mask)
+                return nullptr;
+            return &slots[h & mask];
+        }
+        inline void push()
+        {
+            head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+        inline T *front()
+        {
+            size_t t = tail.load(std::memory_order_relaxed);
+            if(head.load(std::memory_order_acquire) == t)
+                return nullptr;
+            return &slots[t & mask];
+        }
+        inline void pop()
+        {
+            tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+        inline void clear()
+        {
+            tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+        }
+};
+
+#endif // RING_H
@@ -0,0 +1,174 @@
+/*
+    MIT License
+
+    xc-gui GUI for libahp_xc and OpenVLBI using the AHP XC correlators
+    Copyright (C) 2020  Ilia Platone
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef RUNNINGHISTOGRAM_H
+#define RUNNINGHISTOGRAM_H
+
+#include <cmath>
+#include <QVector>
+#include <QPointF>
+
+/*
+ * Histogram of a sliding window updated in O(1) per sample.
+ * Samples are counted when they enter the window and uncounted when they
+ * expire. When a sample falls outside the range, the range doubles towards
+ * it by merging adjacent bin pairs, so the bins never need the samples
+ * again. The range resets once the window empties, and when the samples
+ * occupy less than a quarter of it the owner refits it from the window.
+ */
+class RunningHistogram
+{
+    private:
+        QVector<int> bins;
+        double start { 0.0 };
+        double width { 0.0 };
+        int total { 0 };
+        bool changed { false };
+        bool narrow { false };
+        bool grown { false };
+
+        inline int bin(double value)
+        {
+            return (int)floor((value - start) / width);
+        }
+        void grow(double value)
+        {
+            int size = bins.count();
+            QVector<int> merged(size);
+            while(value < start || bin(value) >= size)
+            {
+                merged.fill(0);
+                int offset = (value < start) ? size / 2 : 0;
+                for(int x = 0; x < size; x++)
+                    merged[offset + x / 2] += bins.at(x);
+                if(value < start)
+                    start -= width * size;
+                width *= 2.0;
+                bins.swap(merged);
+            }
+            grown = true;
+        }
+
+    public:
+        RunningHistogram(int size = 100)
+        {
+            resize(size);
+        }
+
+        inline void resize(int size)
+        {
+            bins = QVector<int>(qMax(2, size + (size & 1)), 0);
+            width = 0.0;
+            total = 0;
+            changed = true;
+            grown = false;
+        }
+        // returns whether the size changed, the histogram is then empty
+        inline bool setSize(int size)
+        {
+            if(qMax(2, size + (size & 1)) == bins.count())
+                return false;
+            resize(size);
+            return true;
+        }
+        inline void clear()
+        {
+            resize(bins.count());
+        }
+        inline int size()
+        {
+            return bins.count();
+        }
+        inline int count()
+        {
+            return total;
+        }
+        inline bool isNarrow()
+        {
+            return narrow;
+        }
+        // restarts the histogram spanning [mn, mx], the caller adds the samples again
+        inline void fit(double mn, double mx)
+        {
+            resize(bins.count());
+            narrow = false;
+            if(mx > mn && std::isfinite(mx - mn)) {
+                width = (mx - mn) / (bins.count() - 1);
+                start = mn - width / 2;
+            }
+        }
+        inline void add(double value)
+        {
+            if(!std::isfinite(value))
+                return;
+            if(width == 0.0) {
+                width = fmax(fabs(value), 1.0) / (1 << 20);
+                start = value - width * bins.count() / 2;
+            }
+            if(value < start || bin(value) >= bins.count())
+                grow(value);
+            bins[bin(value)]++;
+            total++;
+            changed = true;
+        }
+        inline void remove(double value)
+        {
+            if(!std::isfinite(value) || width == 0.0)
+                return;
+            int x = bin(value);
+            if(x < 0 || x >= bins.count() || bins.at(x) == 0)
+                return;
+            bins[x]--;
+            total--;
+            changed = true;
+            if(total == 0) {
+                width = 0.0;
+                grown = false;
+            }
+        }
+        // bin counts against bin centers, from the first to the last non empty bin
+        bool points(QVector<QPointF> &out)
+        {
+            if(!changed)
+                return false;
+            changed = false;
+            out.clear();
+            if(total == 0)
+                return true;
+            int first = 0;
+            int last = bins.count() - 1;
+            while(bins.at(first) == 0)
+                first++;
+            while(bins.at(last) == 0)
+                last--;
+            narrow = grown && (last - first + 1) * 4 < bins.count();
+            out.reserve(last - first + 1);
+            for(int x = first; x <= last; x++)
+                out.append(QPointF(bins.at(x), start + (x + 0.5) * width));
+            return true;
+        }
+};
+
+#endif // RUNNINGHISTOGRAM_H
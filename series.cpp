@@ -5,21 +5,42 @@ Series::Series(QObject *parent) : QObject(parent)
     series = new QLineSeries();
     magnitude = new QLineSeries();
     phase = new QLineSeries();
+    columns = new Columns(ColumnCount);
+    spill = new Spill(ColumnCount);
+    for(int c = 0; c < ColumnCount; c++)
+        statistics.append(new Statistics());
+    setMemoryBudget(SERIES_MEMORY_BUDGET);
+    pyramid = new Pyramid();
+    magnitude_pyramid = new Pyramid();
+    phase_pyramid = new Pyramid();
+    running_histogram = new RunningHistogram();
+    running_histogram_magnitude = new RunningHistogram();
     histogram = new QScatterSeries();
     histogram->setMarkerSize(10);
     histogram_magnitude = new QScatterSeries();
     histogram_magnitude->setMarkerSize(10);
     histogram_phase = new QScatterSeries();
     histogram_phase->setMarkerSize(10);
-    magnitude_stack = new QMap<double, double>();
-    phase_stack = new QMap<double, double>();
-    dark = new QMap<double, double>();
-    stack = new QMap<double, double>();
+    axis = new QVector<double>();
+    magnitude_stack = new Accumulator();
+    phase_stack = new Accumulator();
+    upper = new QLineSeries();
+    lower = new QLineSeries();
+    band = new QAreaSeries(upper, lower);
+    band->setPen(Qt::NoPen);
+    band->setOpacity(0.3);
+    for(QXYSeries *view : { (QXYSeries*)series, (QXYSeries*)magnitude, (QXYSeries*)phase, (QXYSeries*)upper, (QXYSeries*)lower })
+        views.append(new Decimator(view));
+    dark = new QVector<double>();
+    dark_samples = new QVector<QPointF>();
+    stack = new Accumulator();
     histogram_stack = new QMap<double, double>();
     histogram_stack_magnitude = new QMap<double, double>();
     histogram_stack_phase = new QMap<double, double>();
     elemental = new Elemental();
-    raw = new QList<double>();
+    histogram_stream = dsp_stream_new();
+    dsp_stream_add_dim(histogram_stream, 1);
+    dsp_stream_alloc_buffer(histogram_stream, histogram_stream->len);
 }
 
 Series::~Series()
@@ -27,14 +48,33 @@ Series::~Series()
     getSeries()->~QLineSeries();
     getMagnitude()->~QLineSeries();
     getPhase()->~QLineSeries();
+    delete getColumns();
+    delete getSpill();
+    for(Statistics *channel : statistics)
+        delete channel;
+    delete getPyramid();
+    delete getMagnitudePyramid();
+    delete getPhasePyramid();
+    delete running_histogram;
+    delete running_histogram_magnitude;
     getHistogram()->~QScatterSeries();
     getHistogramMagnitude()->~QScatterSeries();
     getHistogramPhase()->~QScatterSeries();
-    getDark()->~QMap<double, double>();
-    getStack()->~QMap<double, double>();
+    delete getAxis();
+    delete getDark();
+    delete dark_samples;
+    delete getStack();
+    delete getMagnitudeStack();
+    delete getPhaseStack();
+    for(Decimator *view : views)
+        delete view;
+    getBand()->~QAreaSeries();
+    upper->~QLineSeries();
+    lower->~QLineSeries();
     getHistogramStack()->~QMap<double, double>();
     getElemental()->~Elemental();
-    getRaw()->~QList();
+    dsp_stream_free_buffer(histogram_stream);
+    dsp_stream_free(histogram_stream);
 }
 
 void Series::setName(QString name)
@@ -44,62 +84,198 @@ void Series::setName(QString name)
 
 void Series::addCount(double min_x, double x, double y, double mag, double phi)
 {
-    if(getSeries()->count() >= 0)
-    {
-        for(int d = getSeries()->count() - 1; d >= 0; d--)
-        {
-            if(getSeries()->at(d).x() < min_x) {
-                getSeries()->remove(d);
-                getRaw()->removeAt(d);
-            }
-        }
+    span = x - min_x;
+    min_x = fmax(min_x, x - SERIES_RAW_SPAN);
+    double row[ColumnCount];
+    getColumns()->lock();
+    while(window < getColumns()->count() && getColumns()->getTime(window) < min_x)
+        leaveWindow(window++);
+    getColumns()->shrink(budget_rows - 1, [ = ] (int r) { spillRow(r); });
+    row[CountsColumn] = (y > -1.0) ? y : NAN;
+    row[MagnitudeColumn] = (mag > -1.0) ? mag : getColumns()->last(MagnitudeColumn);
+    row[PhaseColumn] = (phi > -1.0) ? phi : getColumns()->last(PhaseColumn);
+    getColumns()->append(x, row);
+    for(int c = 0; c < ColumnCount; c++)
+        getStatistics(c)->add(row[c]);
+    addHistogram(CountsColumn, running_histogram, row[CountsColumn]);
+    addHistogram(MagnitudeColumn, running_histogram_magnitude, row[MagnitudeColumn]);
+    getColumns()->unlock();
+    getPyramid()->add(x, row[CountsColumn]);
+    getMagnitudePyramid()->add(x, row[MagnitudeColumn]);
+    getPhasePyramid()->add(x, row[PhaseColumn]);
+    Latency::record(Latency::SeriesAdd, Latency::origin());
+}
+
+void Series::leaveWindow(int row)
+{
+    for(int c = 0; c < ColumnCount; c++)
+        getStatistics(c)->remove(getColumns()->getValue(c, row));
+    running_histogram->remove(getColumns()->getValue(CountsColumn, row));
+    running_histogram_magnitude->remove(getColumns()->getValue(MagnitudeColumn, row));
+}
+
+void Series::spillRow(int row)
+{
+    double values[ColumnCount];
+    for(int c = 0; c < ColumnCount; c++)
+        values[c] = getColumns()->getValue(c, row);
+    if(window > 0)
+        window--;
+    else
+        leaveWindow(row);
+    getSpill()->append(getColumns()->getTime(row), values);
+}
+
+int Series::readRows(int *from, int max, QVector<double> *rows)
+{
+    getColumns()->lock();
+    int stored = getSpill()->count();
+    int skipped = stored + getSpill()->getDropped();
+    *from = qMax(*from, getSpill()->first());
+    if(*from >= stored && *from < skipped)
+        *from = skipped;
+    int n = qMax(0, qMin(max, skipped + getColumns()->count() - *from));
+    if(*from < stored)
+        n = qMin(n, stored - *from);
+    for(int c = -1; c < ColumnCount; c++) {
+        rows[c + 1].resize(n);
+        if(*from < stored)
+            getSpill()->copy(c, *from, n, rows[c + 1].data());
+        else
+            getColumns()->copy(c, *from - skipped, n, rows[c + 1].data());
     }
-    if(getMagnitude()->count() >= 0)
-    {
-        for(int d = getMagnitude()->count() - 1; d >= 0; d--)
-        {
-            if(getMagnitude()->at(d).x() < min_x) {
-                getMagnitude()->remove(d);
-            }
-        }
+    getColumns()->unlock();
+    *from += n;
+    return n;
+}
+
+void Series::addHistogram(int column, RunningHistogram *histogram, double value)
+{
+    histogram->add(value);
+    if(histogram->isNarrow())
+        fitHistogram(column, histogram);
+}
+
+void Series::fitHistogram(int column, RunningHistogram *histogram)
+{
+    double mn = DBL_MAX;
+    double mx = -DBL_MAX;
+    for(int r = window; r < getColumns()->count(); r++) {
+        mn = fmin(mn, getColumns()->getValue(column, r));
+        mx = fmax(mx, getColumns()->getValue(column, r));
     }
-    if(getPhase()->count() >= 0)
-    {
-        for(int d = getPhase()->count() - 1; d >= 0; d--)
-        {
-            if(getPhase()->at(d).x() < min_x) {
-                getPhase()->remove(d);
-            }
+    histogram->fit(mn, mx);
+    for(int r = window; r < getColumns()->count(); r++)
+        histogram->add(getColumns()->getValue(column, r));
+}
+
+void Series::setHistogram(int size, bool counts, bool magnitude)
+{
+    histogram_enabled = counts;
+    histogram_enabled_magnitude = magnitude;
+    getColumns()->lock();
+    if(running_histogram->setSize(size))
+        fitHistogram(CountsColumn, running_histogram);
+    if(running_histogram_magnitude->setSize(size))
+        fitHistogram(MagnitudeColumn, running_histogram_magnitude);
+    getColumns()->unlock();
+}
+
+void Series::publishHistogram(RunningHistogram *histogram, bool enabled, QScatterSeries *series)
+{
+    getColumns()->lock();
+    bool changed = histogram->points(histogram_points);
+    getColumns()->unlock();
+    if(!enabled) {
+        if(series->count() > 0)
+            series->clear();
+        return;
+    }
+    if(changed)
+        series->replace(histogram_points);
+}
+
+Decimator *Series::getView(QXYSeries *series)
+{
+    for(Decimator *view : views)
+        if(view->getSeries() == series)
+            return view;
+    return nullptr;
+}
+
+void Series::publishColumn(int column, Pyramid *pyramid, Decimator *view, bool changed)
+{
+    if(span > SERIES_RAW_SPAN) {
+        if(pyramid->takeChanged()) {
+            double last = pyramid->lastTime();
+            pyramid->query(last - span, last, getWidth() > 0 ? getWidth() : PYRAMID_BUCKETS, *view->getPoints());
+            view->update();
         }
+        return;
     }
-    if(y > -1.0) {
-        getRaw()->append(y);
-        getSeries()->append(x, y);
-    } else y = M_PI * 2;
-    if(mag > -1.0)
-        getMagnitude()->append(x, mag);
-    else if(getMagnitude()->count() > 0)
-        getMagnitude()->append(x, getMagnitude()->at(getMagnitude()->count()-1).y());
-    if(phi > -1.0)
-        getPhase()->append(x, phi);
-    else if(getPhase()->count() > 0)
-        getPhase()->append(x, getPhase()->at(getPhase()->count()-1).y());
-}
-
-void Series::buildHistogram(QXYSeries *series, dsp_stream_p stream, int histogram_size, int *stack_index, QMap<double, double> *stack, QScatterSeries *histogram)
-{
-    int size = 1;
+    if(changed)
+        view->update();
+    getColumns()->lock();
+    if(getColumns()->isEmpty() && !changed) {
+        getColumns()->unlock();
+        return;
+    }
+    if(!view->isStale(getWidth())) {
+        getColumns()->unlock();
+        return;
+    }
+    int first = 0;
+    int spilled = 0;
+    int head = window;
+    if(!getColumns()->isEmpty() && head == 0) {
+        first = getSpill()->lowerBound(getColumns()->getTime(getColumns()->count() - 1) - span);
+        spilled = getSpill()->count() - first;
+    }
+    view->decimate(getWidth(), spilled + getColumns()->count() - head, [ = ] (int row)
+    {
+        if(row < spilled)
+            return QPointF(getSpill()->getTime(first + row), getSpill()->getValue(column, first + row));
+        row += head - spilled;
+        return QPointF(getColumns()->getTime(row), getColumns()->getValue(column, row));
+    });
+    getColumns()->unlock();
+    view->show();
+}
+
+void Series::publish()
+{
+    getColumns()->lock();
+    bool changed = getColumns()->takeChanged();
+    getColumns()->unlock();
+    publishColumn(CountsColumn, getPyramid(), getView(getSeries()), changed);
+    publishColumn(MagnitudeColumn, getMagnitudePyramid(), getView(getMagnitude()), changed);
+    publishColumn(PhaseColumn, getPhasePyramid(), getView(getPhase()), changed);
+    for(Decimator *view : views)
+        view->publish(getWidth());
+    publishHistogram(running_histogram, histogram_enabled, getHistogram());
+    publishHistogram(running_histogram_magnitude, histogram_enabled_magnitude, getHistogramMagnitude());
+}
+
+void Series::buildHistogram(QXYSeries *series, int histogram_size, int *stack_index, QMap<double, double> *stack, QScatterSeries *histogram)
+{
+    const QVector<QPointF> &points = *getView(series)->getPoints();
+    if(points.isEmpty())
+        return;
+    dsp_stream_p stream = histogram_stream;
+    dsp_stream_set_dim(stream, 0, points.count());
+    dsp_stream_alloc_buffer(stream, stream->len);
+    for(int x = 0; x < points.count(); x++)
+        stream->buf[x] = points.at(x).y();
+    int size = fmin(stream->len, histogram_size);
+    stackHistogram(stream, size, stack_index, stack, histogram);
+}
+
+void Series::stackHistogram(dsp_stream_p stream, int size, int *stack_index, QMap<double, double> *stack, QScatterSeries *histogram)
+{
     double mn = DBL_MIN;
     double mx = DBL_MAX;
-    getElemental()->setStreamSize(series->count()+1);
-    if(getElemental()->lock()) {
-        for(int x = 0; x < series->count(); x++)
-            stream->buf[x] = series->at(x).y();
-        size = fmin(stream->len, histogram_size);
-        getElemental()->unlock();
-    } else return;
-    mn = getElemental()->min(0, stream->len);
-    mx = getElemental()->max(0, stream->len);
+    mn = dsp_stats_min(stream->buf, stream->len);
+    mx = dsp_stats_max(stream->buf, stream->len);
     dsp_stream_p histo = getElemental()->histogram(size, stream);
     if(histo == nullptr) return;
     (*stack_index) ++;
@@ -119,50 +295,87 @@ void Series::stackHistogram(double x, double y, int* stack_index, QMap<double, d
     series->append(x, y);
 }
 
-void Series::stackBuffer(QXYSeries *series, QMap<double, double> *stack, double *buf, off_t offset, size_t len, double x_scale, double x_offset, double y_scale, double y_offset)
+void Series::setAxis(size_t len, double x_scale, double x_offset)
 {
-    offset = fmax(0, offset);
-    series->clear();
-    stack_index ++;
-    for(off_t x = offset + 1; x < offset+len; x ++)
+    if((size_t)getAxis()->count() == len && axis_scale == x_scale && axis_offset == x_offset)
+        return;
+    axis_scale = x_scale;
+    axis_offset = x_offset;
+    getAxis()->resize(len);
+    for(size_t x = 0; x < len; x++)
+        (*getAxis())[x] = x * x_scale + x_offset;
+    for(Accumulator* lags : { getStack(), getMagnitudeStack(), getPhaseStack() })
+        lags->resize(len);
+    getDark()->resize(len);
+    binDark();
+}
+
+void Series::binDark()
+{
+    getDark()->fill(0.0);
+    if(axis_scale == 0.0)
+        return;
+    for(const QPointF &sample : *dark_samples)
     {
-        stackValue(series, stack, x * x_scale + x_offset, buf[x] * y_scale + y_offset);
+        int x = qRound((sample.x() - axis_offset) / axis_scale);
+        if(x >= 0 && x < getDark()->count())
+            (*getDark())[x] = sample.y();
     }
 }
 
-void Series::stackValue(QXYSeries *buf, QMap<double, double>* stack, double x, double y)
+void Series::addDark(double x, double y)
 {
-    if(y == 0.0)
-    {
-        if(getStack()->keys().contains(x))
-            getSeries()->append(x, getStack()->value(x));
-        return;
+    dark_samples->append(QPointF(x, y));
+    binDark();
+}
+
+void Series::stackBuffer(QXYSeries *series, Accumulator *stack, double *buf, off_t offset, size_t len, double x_scale, double x_offset, double y_scale, double y_offset, QAreaSeries *band)
+{
+    offset = fmax(0, offset);
+    setAxis(offset + len, x_scale, x_offset);
+    const double *x_axis = getAxis()->constData();
+    const double *darks = getDark()->constData();
+    Decimator *view = getView(series);
+    Decimator *upper_view = (band != nullptr) ? getView(band->upperSeries()) : nullptr;
+    Decimator *lower_view = (band != nullptr) ? getView(band->lowerSeries()) : nullptr;
+    QVector<QPointF> &points = *view->getPoints();
+    points.clear();
+    points.reserve(len);
+    if(band != nullptr) {
+        upper_view->getPoints()->clear();
+        upper_view->getPoints()->reserve(len);
+        lower_view->getPoints()->clear();
+        lower_view->getPoints()->reserve(len);
     }
-    y /= stack_index;
-    if(getDark()->contains(x))
-        y -= getDark()->value(x);
-    if(getStack()->keys().contains(x))
+    stack->add(offset + 1, len - 1, buf, y_scale, y_offset, darks);
+    for(off_t x = offset + 1; x < offset+len; x ++)
     {
-        y += getStack()->value(x) * (stack_index-1.0) / stack_index;
+        if(!stack->has(x))
+            continue;
+        double mean = stack->getMean(x);
+        points.append(QPointF(x_axis[x], mean));
+        if(band != nullptr) {
+            double error = stack->error(x);
+            upper_view->getPoints()->append(QPointF(x_axis[x], mean + error));
+            lower_view->getPoints()->append(QPointF(x_axis[x], mean - error));
+        }
     }
-    if(y != 0) {
-        stack->insert(x, y);
-        buf->append(x, y);
+    view->update();
+    view->publish(getWidth());
+    if(band != nullptr) {
+        upper_view->update();
+        upper_view->publish(getWidth());
+        lower_view->update();
+        lower_view->publish(getWidth());
     }
 }
 
 void Series::stretch(Series* series)
 {
-    double mx = DBL_MIN;
-    double mn = DBL_MAX;
-    for (int x = 0; x < series->getSeries()->count(); x++)
-    {
-        mn = fmin(series->getSeries()->at(x).y(), mn);
-        mx = fmax(series->getSeries()->at(x).y(), mx);
-    }
-    for (int x = 0; x < series->getSeries()->count(); x++)
-    {
-        QPointF p = series->getSeries()->at(x);
-        series->getSeries()->replace(x, p.x(), (p.y() - mn) * M_PI * 2.0 / (mx - mn));
-    }
+    QVector<QPointF> points = series->getSeries()->pointsVector();
+    QPointF mn(DBL_MAX, DBL_MAX);
+    QPointF mx(-DBL_MAX, -DBL_MAX);
+    Kernels::minmax(points.constData(), points.count(), &mn, &mx);
+    Kernels::stretch(points.data(), points.count(), mn.y(), mx.y(), M_PI * 2.0);
+    series->getSeries()->replace(points);
 }
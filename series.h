@@ -1,48 +1,101 @@
 #ifndef SERIES_H
 #define SERIES_H
 
+#include <climits>
 #include <QObject>
 #include <QScatterSeries>
 #include <QSplineSeries>
 #include <QLineSeries>
+#include <QAreaSeries>
 #include "graph.h"
 #include "types.h"
 #include "elemental.h"
+#include "latency.h"
+#include "columns.h"
+#include "spill.h"
+#include "statistics.h"
+#include "accumulator.h"
+#include "decimator.h"
+#include "runninghistogram.h"
+#include "pyramid.h"
+
+#define SERIES_RAW_SPAN 60.0
+#define SERIES_MEMORY_BUDGET 64.0
+#define SERIES_DISK_BUDGET 1024.0
 
 class Series : public QObject
 {
     Q_OBJECT
 private:
-    void stackValue(QXYSeries *buf, QMap<double, double>* stack, double x, double y);
+    void setAxis(size_t len, double x_scale, double x_offset);
+    void binDark();
     void stackHistogram(double x, double y, int *stack_index, QMap<double, double> *stack, QScatterSeries *series);
     void stretch(Series* series);
+    void publishColumn(int column, Pyramid *pyramid, Decimator *view, bool changed);
+    Decimator *getView(QXYSeries *series);
+    void stackHistogram(dsp_stream_p stream, int size, int *stack_index, QMap<double, double> *stack, QScatterSeries *histogram);
+    void spillRow(int row);
+    void leaveWindow(int row);
+    void addHistogram(int column, RunningHistogram *histogram, double value);
+    void fitHistogram(int column, RunningHistogram *histogram);
+    void publishHistogram(RunningHistogram *histogram, bool enabled, QScatterSeries *series);
 
     int stack_index_histogram { 0 };
     int stack_index_histogram_magnitude { 0 };
     int stack_index_histogram_phase { 0 };
-    int stack_index { 0 };
-    QList<double> *raw;
     QLineSeries *series;
     QLineSeries *magnitude;
     QLineSeries *phase;
+    Columns *columns;
+    Spill *spill;
+    int budget_rows;
+    int window { 0 };
+    Pyramid *pyramid;
+    Pyramid *magnitude_pyramid;
+    Pyramid *phase_pyramid;
+    double span { 0.0 };
+    RunningHistogram *running_histogram;
+    RunningHistogram *running_histogram_magnitude;
+    bool histogram_enabled { false };
+    bool histogram_enabled_magnitude { false };
+    QVector<QPointF> histogram_points;
     QScatterSeries *histogram;
     QScatterSeries *histogram_magnitude;
     QScatterSeries *histogram_phase;
     QMap<double, double>* histogram_stack;
     QMap<double, double>* histogram_stack_magnitude;
     QMap<double, double>* histogram_stack_phase;
-    QMap<double, double>* stack;
-    QMap<double, double>* magnitude_stack;
-    QMap<double, double>* phase_stack;
-    QMap<double, double>* dark;
+    QVector<double>* axis;
+    double axis_scale { 0.0 };
+    double axis_offset { 0.0 };
+    Accumulator* stack;
+    Accumulator* magnitude_stack;
+    Accumulator* phase_stack;
+    QLineSeries *upper;
+    QLineSeries *lower;
+    QAreaSeries *band;
+    QList<Decimator*> views;
+    QList<Statistics*> statistics;
+    int width { 0 };
+    QVector<double>* dark;
+    QVector<QPointF>* dark_samples;
     Elemental* elemental;
+    dsp_stream_p histogram_stream;
 public:
+    enum Column {
+        CountsColumn = 0,
+        MagnitudeColumn,
+        PhaseColumn,
+        ColumnCount
+    };
     explicit Series(QObject *parent = nullptr);
     ~Series();
 
     inline void reset()
     {
-        stack_index = 0;
+        getStack()->reset();
+        getMagnitudeStack()->reset();
+        getPhaseStack()->reset();
         stack_index_histogram = 0;
         stack_index_histogram_magnitude = 0;
         stack_index_histogram_phase = 0;
@@ -50,6 +103,18 @@ public:
 
     inline void clear()
     {
+        getColumns()->lock();
+        getColumns()->clear();
+        getSpill()->clear();
+        window = 0;
+        for(Statistics *channel : statistics)
+            channel->clear();
+        running_histogram->clear();
+        running_histogram_magnitude->clear();
+        getColumns()->unlock();
+        getPyramid()->clear();
+        getMagnitudePyramid()->clear();
+        getPhasePyramid()->clear();
         getSeries()->clear();
         getMagnitude()->clear();
         getMagnitudeStack()->clear();
@@ -62,10 +127,11 @@ public:
         getPhaseHistogram()->clear();
         getPhaseHistogramStack()->clear();
         getStack()->clear();
-        getDark()->clear();
+        getAxis()->clear();
+        for(Decimator *view : views)
+            view->clear();
+        clearDark();
         getElemental()->clear();
-        getRaw()->clear();
-        stack_index = 0;
         stack_index_histogram = 0;
         stack_index_histogram_magnitude = 0;
         stack_index_histogram_phase = 0;
@@ -74,15 +140,63 @@ public:
     {
         return series;
     }
+    inline Columns *getColumns()
+    {
+        return columns;
+    }
+    inline Spill *getSpill()
+    {
+        return spill;
+    }
+    // running statistics of a column, read them under the columns lock
+    inline Statistics *getStatistics(int column)
+    {
+        return statistics[column];
+    }
+    // megabytes of in-memory columns, older rows spill to disk, zero keeps everything in memory
+    inline void setMemoryBudget(double megabytes)
+    {
+        getColumns()->lock();
+        budget_rows = (megabytes > 0.0) ? (int)fmin(INT_MAX, megabytes * 1048576.0 / ((ColumnCount + 1) * sizeof(double))) : INT_MAX;
+        getColumns()->unlock();
+    }
+    // megabytes of spilled rows kept on disk, the oldest are deleted past it, zero keeps everything
+    inline void setDiskBudget(double megabytes)
+    {
+        getColumns()->lock();
+        getSpill()->setBudget(megabytes);
+        getColumns()->unlock();
+    }
+    int readRows(int *from, int max, QVector<double> *rows);
+    inline Pyramid *getPyramid()
+    {
+        return pyramid;
+    }
+    inline Pyramid *getMagnitudePyramid()
+    {
+        return magnitude_pyramid;
+    }
+    inline Pyramid *getPhasePyramid()
+    {
+        return phase_pyramid;
+    }
+    inline void setPacketTime(double packettime)
+    {
+        getPyramid()->setBase(packettime);
+        getMagnitudePyramid()->setBase(packettime);
+        getPhasePyramid()->setBase(packettime);
+        for(Statistics *channel : statistics)
+            channel->setTau0(packettime);
+    }
     inline QLineSeries *getMagnitude()
     {
         return magnitude;
     }
-    inline QMap<double, double> *getMagnitudeStack()
+    inline Accumulator *getMagnitudeStack()
     {
         return magnitude_stack;
     }
-    inline QMap<double, double> *getPhaseStack()
+    inline Accumulator *getPhaseStack()
     {
         return phase_stack;
     }
@@ -90,10 +204,32 @@ public:
     {
         return phase;
     }
-    inline QMap<double, double> *getStack()
+    inline Accumulator *getStack()
     {
         return stack;
     }
+    inline QAreaSeries *getBand()
+    {
+        return band;
+    }
+    inline void setDecay(double decay)
+    {
+        getStack()->setDecay(decay);
+        getMagnitudeStack()->setDecay(decay);
+        getPhaseStack()->setDecay(decay);
+    }
+    inline double getDecay()
+    {
+        return getStack()->getDecay();
+    }
+    inline void setWidth(int pixels)
+    {
+        width = pixels;
+    }
+    inline int getWidth()
+    {
+        return width;
+    }
     inline QScatterSeries *getMagnitudeHistogram()
     {
         return histogram_magnitude;
@@ -134,17 +270,27 @@ public:
     {
         return histogram_stack_phase;
     }
-    inline QMap<double, double> *getDark()
+    inline QVector<double> *getAxis()
+    {
+        return axis;
+    }
+    inline QVector<double> *getDark()
     {
         return dark;
     }
-    inline Elemental *getElemental()
+    inline bool hasDark()
     {
-        return elemental;
+        return !dark_samples->isEmpty();
     }
-    inline QList<double> *getRaw()
+    inline void clearDark()
     {
-        return raw;
+        dark_samples->clear();
+        dark->fill(0.0);
+    }
+    void addDark(double x, double y);
+    inline Elemental *getElemental()
+    {
+        return elemental;
     }
     int *getHistogramStackIndex()
     {
@@ -158,12 +304,26 @@ public:
     {
         return &stack_index_histogram_phase;
     }
-    inline int count() { return getSeries()->count(); }
+    inline QVector<QPointF> *getSeriesPoints()
+    {
+        return getView(getSeries())->getPoints();
+    }
+    inline QVector<QPointF> *getMagnitudePoints()
+    {
+        return getView(getMagnitude())->getPoints();
+    }
+    inline QVector<QPointF> *getPhasePoints()
+    {
+        return getView(getPhase())->getPoints();
+    }
+    inline int count() { return getSeriesPoints()->count(); }
     void setName(QString name);
     void fill(double* buf, off_t offset, size_t len);
     void addCount(double min_x, double x, double y, double mag, double phi);
-    void stackBuffer(QXYSeries *series, QMap<double, double> *stack, double *buf, off_t offset, size_t len, double x_scale, double x_offset, double y_scale, double y_offset);
-    void buildHistogram(QXYSeries *series, dsp_stream_p stream, int histogram_size, int *stack_index, QMap<double, double> *stack, QScatterSeries *histogram);
+    void publish();
+    void setHistogram(int size, bool counts, bool magnitude);
+    void stackBuffer(QXYSeries *series, Accumulator *stack, double *buf, off_t offset, size_t len, double x_scale, double x_offset, double y_scale, double y_offset, QAreaSeries *band = nullptr);
+    void buildHistogram(QXYSeries *series, int histogram_size, int *stack_index, QMap<double, double> *stack, QScatterSeries *histogram);
 signals:
 
 };
@@ -0,0 +1,127 @@
+/*
+    MIT License
+
+    xc-gui GUI for libahp_xc and OpenVLBI using the AHP XC correlators
+    Copyright (C) 2020  Ilia Platone
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <cstdlib>
+#include <cmath>
+#include <ahp_xc.h>
+#include "recorder.h"
+
+/*
+ * Packet source standing in for the correlator.
+ * The geometry of the packets is described by a capture header, packets
+ * handed to read() must come from allocPacket().
+ */
+class Source
+{
+    protected:
+        Recorder::Header header;
+
+    public:
+        Source()
+        {
+            memset(&header, 0, sizeof(Recorder::Header));
+        }
+        virtual ~Source() {}
+        Source(const Source&) = delete;
+        Source& operator=(const Source&) = delete;
+
+        virtual bool isOpen() = 0;
+        virtual int read(ahp_xc_packet *packet) = 0;
+        virtual bool atEnd()
+        {
+            return false;
+        }
+        virtual void rewind() {}
+        virtual void setSpeed(double s)
+        {
+            (void)s;
+        }
+
+        // baselines enumerate the line pairs (x, y > x) with x major
+        static int lineIndex(int nlines, int baseline, int order)
+        {
+            if(order < 0 || order > 1)
+                return -1;
+            for(int x = 0; x < nlines - 1; x++)
+            {
+                if(baseline < nlines - 1 - x)
+                    return order == 0 ? x : x + 1 + baseline;
+                baseline -= nlines - 1 - x;
+            }
+            return -1;
+        }
+        static int baselineIndex(int nlines, const int *lines, int count)
+        {
+            if(count != 2 || lines[0] == lines[1])
+                return -1;
+            int a = fmin(lines[0], lines[1]);
+            int b = fmax(lines[0], lines[1]);
+            int baseline = b - a - 1;
+            for(int x = 0; x < a; x++)
+                baseline += nlines - 1 - x;
+            return baseline;
+        }
+
+        inline const Recorder::Header *getHeader()
+        {
+            return &header;
+        }
+        inline ahp_xc_packet *allocPacket()
+        {
+            ahp_xc_packet *packet = (ahp_xc_packet*)calloc(1, sizeof(ahp_xc_packet));
+            packet->counts = (unsigned long*)calloc(header.nlines, sizeof(unsigned long));
+            packet->autocorrelations = (ahp_xc_sample*)calloc(header.nlines, sizeof(ahp_xc_sample));
+            packet->crosscorrelations = (ahp_xc_sample*)calloc(header.nbaselines, sizeof(ahp_xc_sample));
+            for(quint32 x = 0; x < header.nlines; x++)
+            {
+                packet->autocorrelations[x].lag_size = header.autolag;
+                packet->autocorrelations[x].correlations = (ahp_xc_correlation*)calloc(header.autolag, sizeof(ahp_xc_correlation));
+            }
+            for(quint32 x = 0; x < header.nbaselines; x++)
+            {
+                packet->crosscorrelations[x].lag_size = header.crosslag;
+                packet->crosscorrelations[x].correlations = (ahp_xc_correlation*)calloc(header.crosslag, sizeof(ahp_xc_correlation));
+            }
+            return packet;
+        }
+        inline void freePacket(ahp_xc_packet *packet)
+        {
+            if(packet == nullptr)
+                return;
+            for(quint32 x = 0; x < header.nlines; x++)
+                free(packet->autocorrelations[x].correlations);
+            for(quint32 x = 0; x < header.nbaselines; x++)
+                free(packet->crosscorrelations[x].correlations);
+            free(packet->autocorrelations);
+            free(packet->crosscorrelations);
+            free(packet->counts);
+            free(packet);
+        }
+};
+
+#endif // SOURCE_H
@@ -0,0 +1,268 @@
+/*
+    MIT License
+
+    xc-gui GUI for libahp_xc and OpenVLBI using the AHP XC correlators
+    Copyright (C) 2020  Ilia Platone
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef SPILL_H
+#define SPILL_H
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <QtGlobal>
+#include <QFile>
+#include <QList>
+#include <QVector>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+
+#define SPILL_CHUNK_SHIFT 16
+#define SPILL_CHUNK_ROWS (1 << SPILL_CHUNK_SHIFT)
+#define SPILL_MAPPED 4
+
+/*
+ * Out of core tier of a Columns store. Rows evicted from memory are
+ * appended to fixed size chunk files in a spill directory shared by the
+ * whole process under the application data directory, laid out column
+ * by column like the rings they come from, and read back through memory
+ * mappings. At most SPILL_MAPPED chunks are mapped at once, so the
+ * resident cost stays bounded whatever the session length, and past the
+ * disk budget the oldest chunks are deleted. Rows are addressed by their
+ * index since the last clear, in time order, rows before first() are
+ * gone. The files go away with clear() or the object.
+ * Callers serialize access, the owning Series uses its columns lock.
+ */
+class Spill
+{
+    private:
+        struct Chunk
+        {
+            QFile *file;
+            double *data;
+            double first;
+        };
+        int columns;
+        int id;
+        int size { 0 };
+        int dropped { 0 };
+        int released { 0 };
+        int budget_chunks { INT_MAX };
+        bool failed { false };
+        QVector<Chunk> chunks;
+        QList<int> mapped;
+
+        static QTemporaryDir *directory()
+        {
+            static QTemporaryDir dir(QStandardPaths::standardLocations(QStandardPaths::AppDataLocation).at(0) + "/spill-XXXXXX");
+            return &dir;
+        }
+        static int nextId()
+        {
+            static std::atomic<int> ids { 0 };
+            return ids++;
+        }
+        inline qint64 chunkBytes()
+        {
+            return (qint64)SPILL_CHUNK_ROWS * (columns + 1) * sizeof(double);
+        }
+        inline Chunk &chunkAt(int c)
+        {
+            return chunks[c - released];
+        }
+        void unmap(int c)
+        {
+            Chunk &chunk = chunkAt(c);
+            if(chunk.data == nullptr)
+                return;
+            chunk.file->unmap((uchar*)chunk.data);
+            chunk.data = nullptr;
+        }
+        double *map(int c)
+        {
+            if(c < released)
+                return nullptr;
+            if(!mapped.isEmpty() && mapped.last() == c)
+                return chunkAt(c).data;
+            Chunk &chunk = chunkAt(c);
+            if(chunk.data == nullptr)
+                chunk.data = (double*)chunk.file->map(0, chunkBytes());
+            if(chunk.data == nullptr)
+                return nullptr;
+            mapped.removeOne(c);
+            mapped.append(c);
+            while(mapped.count() > SPILL_MAPPED)
+                unmap(mapped.takeFirst());
+            return chunk.data;
+        }
+        void releaseChunk()
+        {
+            unmap(released);
+            mapped.removeOne(released);
+            chunks[0].file->remove();
+            delete chunks[0].file;
+            chunks.removeFirst();
+            released++;
+        }
+        bool addChunk()
+        {
+            if(!directory()->isValid())
+                return false;
+            while(chunks.count() > 0 && chunks.count() >= budget_chunks)
+                releaseChunk();
+            QFile *file = new QFile(directory()->filePath(QString::number(id) + "-" + QString::number(released + chunks.count()) + ".chunk"));
+            if(!file->open(QIODevice::ReadWrite) || !file->resize(chunkBytes())) {
+                delete file;
+                return false;
+            }
+            Chunk chunk;
+            chunk.file = file;
+            chunk.data = nullptr;
+            chunk.first = 0.0;
+            chunks.append(chunk);
+            return true;
+        }
+        inline double *column(double *data, int column)
+        {
+            return data + (qint64)(column + 1) * SPILL_CHUNK_ROWS;
+        }
+
+    public:
+        Spill(int count) : columns(count), id(nextId()) {}
+        ~Spill()
+        {
+            clear();
+        }
+        Spill(const Spill&) = delete;
+        Spill& operator=(const Spill&) = delete;
+
+        // rows written since the last clear
+        inline int count()
+        {
+            return size;
+        }
+        // index of the oldest row still held on disk
+        inline int first()
+        {
+            return released << SPILL_CHUNK_SHIFT;
+        }
+        // megabytes of chunk files to keep, the oldest chunks are deleted past it, zero keeps everything
+        void setBudget(double megabytes)
+        {
+            budget_chunks = (megabytes > 0.0) ? (int)fmax(1, fmin(INT_MAX, megabytes * 1048576.0 / chunkBytes())) : INT_MAX;
+            while(chunks.count() > budget_chunks)
+                releaseChunk();
+        }
+        // rows that could not be written, a failed spill stops storing so they follow the stored ones
+        inline int getDropped()
+        {
+            return dropped;
+        }
+        // appends a row, row holds one value per column
+        bool append(double x, const double *row)
+        {
+            int c = size >> SPILL_CHUNK_SHIFT;
+            if(!failed && c == released + chunks.count())
+                failed = !addChunk();
+            double *data = failed ? nullptr : map(c);
+            if(data == nullptr) {
+                failed = true;
+                dropped++;
+                return false;
+            }
+            int r = size & (SPILL_CHUNK_ROWS - 1);
+            if(r == 0)
+                chunkAt(c).first = x;
+            data[r] = x;
+            for(int v = 0; v < columns; v++)
+                column(data, v)[r] = row[v];
+            size++;
+            return true;
+        }
+        inline double getTime(int row)
+        {
+            double *data = map(row >> SPILL_CHUNK_SHIFT);
+            return (data != nullptr) ? data[row & (SPILL_CHUNK_ROWS - 1)] : NAN;
+        }
+        inline double getValue(int col, int row)
+        {
+            double *data = map(row >> SPILL_CHUNK_SHIFT);
+            return (data != nullptr) ? column(data, col)[row & (SPILL_CHUNK_ROWS - 1)] : NAN;
+        }
+        // index of the first held row not older than x
+        int lowerBound(double x)
+        {
+            int lo = released;
+            int hi = (size + SPILL_CHUNK_ROWS - 1) >> SPILL_CHUNK_SHIFT;
+            while(lo < hi) {
+                int mid = (lo + hi) / 2;
+                if(chunkAt(mid).first < x)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            int first = qMax(released, lo - 1) << SPILL_CHUNK_SHIFT;
+            int last = qMin(size, lo << SPILL_CHUNK_SHIFT);
+            while(first < last) {
+                int mid = (first + last) / 2;
+                if(getTime(mid) < x)
+                    first = mid + 1;
+                else
+                    last = mid;
+            }
+            return first;
+        }
+        // copies count values of a column starting at row, negative columns are the timestamps
+        void copy(int col, int row, int count, double *dst)
+        {
+            while(count > 0) {
+                double *data = map(row >> SPILL_CHUNK_SHIFT);
+                int r = row & (SPILL_CHUNK_ROWS - 1);
+                int n = qMin(count, SPILL_CHUNK_ROWS - r);
+                if(data != nullptr)
+                    memcpy(dst, (col < 0 ? data : column(data, col)) + r, n * sizeof(double));
+                else
+                    std::fill(dst, dst + n, NAN);
+                dst += n;
+                row += n;
+                count -= n;
+            }
+        }
+        void clear()
+        {
+            mapped.clear();
+            for(int c = 0; c < chunks.count(); c++) {
+                unmap(released + c);
+                chunks[c].file->remove();
+                delete chunks[c].file;
+            }
+            chunks.clear();
+            released = 0;
+            size = 0;
+            dropped = 0;
+            failed = false;
+        }
+};
+
+#endif // SPILL_H
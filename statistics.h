@@ -0,0 +1,231 @@
+/*
+    MIT License
+
+    xc-gui GUI for libahp_xc and OpenVLBI using the AHP XC correlators
+    Copyright (C) 2020  Ilia Platone
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <cmath>
+#include <QtGlobal>
+#include <QList>
+#include <QVector>
+
+#define STATISTICS_OCTAVES 12
+
+/*
+ * Running statistics of one channel over the rows of a sliding window.
+ * Values enter with add() and leave in the same order with remove(), non
+ * finite values take a row but no part in the statistics. Mean and RMS
+ * come from compensated sums, minimum and maximum from monotonic deques,
+ * all in O(1) amortised per row. The overlapping Allan deviation runs
+ * over every sample since the last clear at the octave averaging times
+ * tau = 2^k * tau0, from the sums of the last two groups of 2^k samples,
+ * which costs O(STATISTICS_OCTAVES) per sample.
+ */
+class Statistics
+{
+    private:
+        struct Extreme
+        {
+            qint64 row;
+            double value;
+        };
+        qint64 added { 0 };
+        qint64 removed { 0 };
+        int valid { 0 };
+        double sum { 0.0 };
+        double sum_c { 0.0 };
+        double squares { 0.0 };
+        double squares_c { 0.0 };
+        QList<Extreme> minima;
+        QList<Extreme> maxima;
+        double tau0 { 1.0 };
+        qint64 samples { 0 };
+        QVector<double> history;
+        double recent[STATISTICS_OCTAVES];
+        double previous[STATISTICS_OCTAVES];
+        double allan[STATISTICS_OCTAVES];
+        qint64 terms[STATISTICS_OCTAVES];
+
+        static inline void kahan(double *s, double *c, double value)
+        {
+            double y = value - *c;
+            double t = *s + y;
+            *c = (t - *s) - y;
+            *s = t;
+        }
+        inline int mask()
+        {
+            return history.count() - 1;
+        }
+        inline double sample(qint64 n)
+        {
+            return history[n & mask()];
+        }
+        // recomputes the group sums from the history to drop the rounding drift
+        void resum(qint64 n)
+        {
+            for(int l = 0; l < STATISTICS_OCTAVES; l++) {
+                qint64 m = (qint64)1 << l;
+                recent[l] = 0.0;
+                previous[l] = 0.0;
+                for(qint64 k = 0; k < qMin(m, n + 1); k++)
+                    recent[l] += sample(n - k);
+                for(qint64 k = m; k < qMin(2 * m, n + 1); k++)
+                    previous[l] += sample(n - k);
+            }
+        }
+        void addAllan(double value)
+        {
+            if(history.isEmpty())
+                history.resize(2 << STATISTICS_OCTAVES);
+            qint64 n = samples++;
+            history[n & mask()] = value;
+            if((n & mask()) == 0 && n > 0) {
+                resum(n);
+            } else {
+                for(int l = 0; l < STATISTICS_OCTAVES; l++) {
+                    qint64 m = (qint64)1 << l;
+                    recent[l] += value;
+                    if(n >= m) {
+                        recent[l] -= sample(n - m);
+                        previous[l] += sample(n - m);
+                    }
+                    if(n >= 2 * m)
+                        previous[l] -= sample(n - 2 * m);
+                }
+            }
+            for(int l = 0; l < STATISTICS_OCTAVES; l++) {
+                qint64 m = (qint64)1 << l;
+                if(n < 2 * m - 1)
+                    break;
+                double d = recent[l] - previous[l];
+                allan[l] += d * d;
+                terms[l]++;
+            }
+        }
+
+    public:
+        Statistics()
+        {
+            clear();
+        }
+
+        inline void setTau0(double value)
+        {
+            tau0 = value;
+        }
+        inline double getTau0()
+        {
+            return tau0;
+        }
+        void add(double value)
+        {
+            qint64 row = added++;
+            if(!std::isfinite(value))
+                return;
+            valid++;
+            kahan(&sum, &sum_c, value);
+            kahan(&squares, &squares_c, value * value);
+            while(!minima.isEmpty() && minima.last().value >= value)
+                minima.removeLast();
+            minima.append({ row, value });
+            while(!maxima.isEmpty() && maxima.last().value <= value)
+                maxima.removeLast();
+            maxima.append({ row, value });
+            addAllan(value);
+        }
+        // drops the oldest row, value is the one it was added with
+        void remove(double value)
+        {
+            qint64 row = removed++;
+            if(!std::isfinite(value))
+                return;
+            if(--valid == 0) {
+                sum = sum_c = squares = squares_c = 0.0;
+            } else {
+                kahan(&sum, &sum_c, -value);
+                kahan(&squares, &squares_c, -value * value);
+            }
+            if(!minima.isEmpty() && minima.first().row == row)
+                minima.removeFirst();
+            if(!maxima.isEmpty() && maxima.first().row == row)
+                maxima.removeFirst();
+        }
+        void clear()
+        {
+            added = removed = 0;
+            valid = 0;
+            sum = sum_c = squares = squares_c = 0.0;
+            minima.clear();
+            maxima.clear();
+            samples = 0;
+            for(int l = 0; l < STATISTICS_OCTAVES; l++) {
+                recent[l] = previous[l] = allan[l] = 0.0;
+                terms[l] = 0;
+            }
+        }
+        // finite values in the window
+        inline int count()
+        {
+            return valid;
+        }
+        inline double getMean()
+        {
+            return (valid > 0) ? sum / valid : NAN;
+        }
+        inline double getRMS()
+        {
+            return (valid > 0) ? sqrt(fmax(0.0, squares / valid)) : NAN;
+        }
+        inline double getMin()
+        {
+            return minima.isEmpty() ? NAN : minima.first().value;
+        }
+        inline double getMax()
+        {
+            return maxima.isEmpty() ? NAN : maxima.first().value;
+        }
+        // octaves with at least one Allan term
+        inline int octaves()
+        {
+            int l = 0;
+            while(l < STATISTICS_OCTAVES && terms[l] > 0)
+                l++;
+            return l;
+        }
+        inline double getTau(int octave)
+        {
+            return tau0 * ((qint64)1 << octave);
+        }
+        inline double getAllanDeviation(int octave)
+        {
+            if(terms[octave] == 0)
+                return NAN;
+            double m = (double)((qint64)1 << octave);
+            return sqrt(allan[octave] / (2.0 * m * m * terms[octave]));
+        }
+};
+
+#endif // STATISTICS_H
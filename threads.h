@@ -27,20 +27,39 @@
 #define THREADS_H
 
 #include <cmath>
+#include <functional>
 #include <QThread>
 #include <QDateTime>
 #include <QEventLoop>
 #include <QWidget>
 #include <QMutex>
+#include <QSemaphore>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QList>
 #include <QTimer>
 
+/*
+ * Worker thread driven by wakeups and deadlines.
+ * threadLoop is emitted when wake() has been called, no sooner than timer
+ * milliseconds after the previous loop, or when the periodic deadline of
+ * loop milliseconds expires. A loop of 0 makes the thread purely event
+ * driven. wake(msec) schedules a single loop msec milliseconds from now.
+ * Work handed to post() runs on the thread as soon as it is queued.
+ * The threadLoop handler must call unlock() once done.
+ */
 class Thread : public QThread
 {
         Q_OBJECT
     private:
         QObject* parent;
-        QMutex mutex;
-        int next_ms;
+        QSemaphore busy { 1 };
+        QMutex waitMutex;
+        QWaitCondition wakeup;
+        QElapsedTimer clock;
+        QList<std::function<void()>> queue;
+        bool pending { false };
+        qint64 due { -1 };
         int timer_ms;
         int loop_ms;
         QString Name;
@@ -51,37 +70,116 @@ class Thread : public QThread
             parent = p;
             timer_ms = timer;
             loop_ms = loop;
-            next_ms = timer_ms;
             Name = n;
+            clock.start();
         }
         void run()
         {
             running = true;
-            lastPollTime = QDateTime::currentDateTimeUtc();
+            qint64 last = clock.elapsed() - timer_ms;
+            qint64 deadline = clock.elapsed() + loop_ms;
+            waitMutex.lock();
+            pending = true;
+            waitMutex.unlock();
             while(!isInterruptionRequested())
             {
+                QList<std::function<void()>> work;
+                bool loop = false;
+                waitMutex.lock();
+                while(!isInterruptionRequested() && queue.isEmpty())
+                {
+                    qint64 now = clock.elapsed();
+                    if(pending && now - last >= timer_ms)
+                    {
+                        loop = true;
+                        break;
+                    }
+                    if(loop_ms > 0 && now >= deadline)
+                    {
+                        loop = true;
+                        break;
+                    }
+                    if(due >= 0 && now >= due)
+                    {
+                        loop = true;
+                        break;
+                    }
+                    qint64 timeout = -1;
+                    if(pending)
+                        timeout = last + timer_ms - now;
+                    if(loop_ms > 0)
+                        timeout = (timeout < 0) ? deadline - now : qMin(timeout, deadline - now);
+                    if(due >= 0)
+                        timeout = (timeout < 0) ? due - now : qMin(timeout, due - now);
+                    if(timeout < 0)
+                        wakeup.wait(&waitMutex);
+                    else
+                        wakeup.wait(&waitMutex, (unsigned long)timeout);
+                }
+                if(loop)
+                {
+                    pending = false;
+                    due = -1;
+                }
+                work.swap(queue);
+                waitMutex.unlock();
+                for(std::function<void()> w : work)
+                    w();
+                if(!loop || isInterruptionRequested())
+                    continue;
+                last = clock.elapsed();
+                if(loop_ms > 0)
+                {
+                    deadline += loop_ms;
+                    if(deadline <= last)
+                        deadline = last + loop_ms;
+                }
                 lastPollTime = QDateTime::currentDateTimeUtc();
-                next_ms = loop_ms;
                 if(lock())
-                {
                     emit threadLoop(this);
-                    QThread::msleep(next_ms);
-                }
+                else
+                    wake();
             }
             running = false;
         }
         void stop()
         {
             requestInterruption();
-            next_ms = timer_ms;
+            waitMutex.lock();
+            wakeup.wakeAll();
+            waitMutex.unlock();
+        }
+        void wake()
+        {
+            waitMutex.lock();
+            pending = true;
+            wakeup.wakeAll();
+            waitMutex.unlock();
+        }
+        void wake(int msec)
+        {
+            waitMutex.lock();
+            qint64 at = clock.elapsed() + qMax(0, msec);
+            if(due < 0 || at < due)
+                due = at;
+            wakeup.wakeAll();
+            waitMutex.unlock();
+        }
+        void post(std::function<void()> work)
+        {
+            waitMutex.lock();
+            queue.append(work);
+            wakeup.wakeAll();
+            waitMutex.unlock();
         }
         bool lock()
         {
-            return mutex.tryLock(loop_ms);
+            return busy.tryAcquire(1, qMax(1, loop_ms > 0 ? loop_ms : timer_ms));
         }
         void unlock()
         {
-            mutex.unlock();
+            if(busy.available() == 0)
+                busy.release();
         }
         void setTimer(int timer)
         {
@@ -90,6 +188,7 @@ class Thread : public QThread
         void setLoop(int loop)
         {
             loop_ms = loop;
+            wake();
         }
         QString getName()
         {
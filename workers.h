@@ -0,0 +1,136 @@
+/*
+    MIT License
+
+    xc-gui GUI for libahp_xc and OpenVLBI using the AHP XC correlators
+    Copyright (C) 2020  Ilia Platone
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+*/
+
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+
+/*
+ * Fixed pool of worker threads running indexed tasks.
+ * run() hands out the indexes 0 to count - 1 to the workers and to the
+ * calling thread, and returns once every task has completed and every
+ * worker is idle again, so the job may reference the caller's stack.
+ * One thread means no workers, tasks then run inline on the caller.
+ */
+class Workers
+{
+    public:
+        typedef std::function<void(int)> job_func;
+    private:
+        std::vector<std::thread> threads;
+        std::mutex mutex;
+        std::condition_variable wakeup;
+        std::condition_variable idle;
+        job_func job;
+        std::atomic<int> next { 0 };
+        std::atomic<int> finished { 0 };
+        int total { 0 };
+        int busy { 0 };
+        unsigned long generation { 0 };
+        bool quit { false };
+
+        inline void drain(const job_func &task, int count)
+        {
+            int x;
+            while((x = next.fetch_add(1, std::memory_order_acq_rel)) < count)
+            {
+                task(x);
+                finished.fetch_add(1, std::memory_order_acq_rel);
+            }
+        }
+        inline void worker()
+        {
+            unsigned long seen = 0;
+            std::unique_lock<std::mutex> lock(mutex);
+            while(true)
+            {
+                wakeup.wait(lock, [&] { return quit || generation != seen; });
+                if(quit)
+                    return;
+                seen = generation;
+                busy++;
+                // run() rewrites the job only once no worker is busy
+                job_func task = job;
+                int count = total;
+                lock.unlock();
+                drain(task, count);
+                lock.lock();
+                busy--;
+                idle.notify_all();
+            }
+        }
+    public:
+        Workers(int count = 1)
+        {
+            for(int x = 1; x < count; x++)
+                threads.push_back(std::thread(&Workers::worker, this));
+        }
+        ~Workers()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                quit = true;
+            }
+            wakeup.notify_all();
+            for(std::thread &t : threads)
+                t.join();
+        }
+        Workers(const Workers&) = delete;
+        Workers& operator=(const Workers&) = delete;
+
+        inline int count()
+        {
+            return threads.size() + 1;
+        }
+        inline void run(int count, job_func func)
+        {
+            if(threads.empty() || count < 2)
+            {
+                for(int x = 0; x < count; x++)
+                    func(x);
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                job = func;
+                total = count;
+                finished.store(0, std::memory_order_relaxed);
+                next.store(0, std::memory_order_release);
+                generation++;
+            }
+            wakeup.notify_all();
+            drain(func, count);
+            std::unique_lock<std::mutex> lock(mutex);
+            idle.wait(lock, [&] { return busy == 0 && finished.load(std::memory_order_acquire) >= total; });
+        }
+};
+
+#endif // WORKERS_H